@@ -0,0 +1,90 @@
+#include "pch.h"
+#include "EdgeAdjacency.h"
+#include "IndexStorage.h"
+
+const unsigned int EdgeAdjacency::NO_TRIANGLE;
+
+unsigned int EdgeAdjacency::Slot(unsigned int a, unsigned int b) const
+{
+	//Fibonacci hashing of the 64-bit key, then linear probing.
+	unsigned long long key = ((unsigned long long)a << 32) | b;
+	unsigned int slot = HashSlot(key, tableMask);
+	for (;;) {
+		unsigned int record = table[slot];
+		if (record == NO_TRIANGLE || (edges[record].vertices[0] == a && edges[record].vertices[1] == b)) {
+			return slot;
+		}
+		slot = (slot + 1) & tableMask;
+	}
+}
+
+void EdgeAdjacency::Build(const unsigned int* indices, unsigned int triangleCount)
+{
+	//A closed mesh has 1.5 edges per triangle; a table of at least twice the 3 edges per
+	//triangle keeps the load factor under one half for any mesh.
+	tableMask = HashTableMask(6 * triangleCount);
+	table.assign(tableMask + 1, NO_TRIANGLE);
+	edges.clear();
+	edges.reserve(3 * triangleCount / 2 + 16);
+	fanRecords = 0;
+
+	for (unsigned int t = 0; t < triangleCount; t++) {
+		const unsigned int* triangle = indices + 3 * t;
+		for (int i = 0; i < 3; i++) {
+			unsigned int a = triangle[i];
+			unsigned int b = triangle[(i + 1) % 3];
+			unsigned int opposite = triangle[(i + 2) % 3];
+			if (a == b) {
+				continue;
+			}
+			if (b < a) {
+				std::swap(a, b);
+			}
+
+			unsigned int slot = Slot(a, b);
+			unsigned int record = table[slot];
+			if (record == NO_TRIANGLE) {
+				Edge edge = { { a, b }, { t, NO_TRIANGLE }, { opposite, NO_TRIANGLE } };
+				table[slot] = (unsigned int)edges.size();
+				edges.push_back(edge);
+			} else if (edges[record].IsBoundary()) {
+				edges[record].triangles[1] = t;
+				edges[record].opposite[1] = opposite;
+			} else {
+				Edge edge = { { a, b }, { edges[record].triangles[0], t }, { edges[record].opposite[0], opposite } };
+				edges.push_back(edge);
+				fanRecords++;
+			}
+		}
+	}
+
+	if (fanRecords == 0) {
+		return;
+	}
+	//Fan records were appended at the end; move each one behind the first record of its
+	//edge. The table holds first records only, so it gives the group of every record.
+	//Counting sort on the group, as HalfEdgeMesh sorts half-edges by origin: offsets first
+	//hold the end of each group, and filling backwards keeps the records of a group in
+	//order and moves the offsets to the start.
+	unsigned int recordCount = (unsigned int)edges.size();
+	ScratchVector<unsigned int> groups(recordCount, 0, edges.get_allocator());
+	ScratchVector<unsigned int> offsets(recordCount + 1, 0, edges.get_allocator());
+	for (unsigned int i = 0; i < recordCount; i++) {
+		groups[i] = table[Slot(edges[i].vertices[0], edges[i].vertices[1])];
+		offsets[groups[i]]++;
+	}
+	for (unsigned int group = 1; group <= recordCount; group++) {
+		offsets[group] += offsets[group - 1];
+	}
+	ScratchVector<Edge> grouped(recordCount, Edge(), edges.get_allocator());
+	for (unsigned int i = recordCount; i-- > 0;) {
+		grouped[--offsets[groups[i]]] = edges[i];
+	}
+	edges.swap(grouped);
+	//Every first record is still first in its group, which now starts at its offset.
+	for (unsigned int& record : table) {
+		if (record != NO_TRIANGLE) {
+			record = offsets[record];
+		}
+	}
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "ScratchArena.h"
+#include <algorithm>
+
+//Triangle adjacency straight from an index buffer. Every edge is keyed by its sorted
+//vertex index pair in an open-addressing hash table, so building is O(n) and no vertex
+//positions are compared.
+class EdgeAdjacency
+{
+public:
+	static const unsigned int NO_TRIANGLE = 0xFFFFFFFF;
+
+	//vertices[0] < vertices[1]. opposite[i] is the vertex of triangles[i] that is not on
+	//the edge. A boundary edge has triangles[1] == NO_TRIANGLE. On a non-manifold edge
+	//every further triangle gets its own record paired with the first one, and all records
+	//of an edge are adjacent in GetEdges().
+	struct Edge
+	{
+		unsigned int vertices[2];
+		unsigned int triangles[2];
+		unsigned int opposite[2];
+
+		bool IsBoundary() const { return triangles[1] == NO_TRIANGLE; }
+	};
+
+	explicit EdgeAdjacency(ScratchArena* arena = nullptr) : edges(arena), table(arena) {}
+
+	//Triangle t is made of indices[3 * t] to indices[3 * t + 2]. Degenerate edges with
+	//both ends on the same vertex are skipped.
+	void Build(const unsigned int* indices, unsigned int triangleCount);
+
+	const ScratchVector<Edge>& GetEdges() const { return edges; }
+
+private:
+	unsigned int Slot(unsigned int a, unsigned int b) const;
+
+	ScratchVector<Edge> edges;
+	//Number of records added for non-manifold edges by the last Build.
+	unsigned int fanRecords = 0;
+	//Index of the first record of every edge, or NO_TRIANGLE for an empty slot.
+	ScratchVector<unsigned int> table;
+	unsigned int tableMask = 0;
+};
@@ -0,0 +1,192 @@
+#pragma once
+
+#include "Triangle.h"
+#include "Kdtree.h"
+#include "EdgeAdjacency.h"
+#include "HalfEdgeMesh.h"
+#include "EdgeOperators.h"
+#include "ScratchArena.h"
+#include <algorithm>
+
+//The extraction loops of PopulateEdgeList, one chunk of a surface at a time. They are
+//generic over the edge operator and the index width, so each combination gets its own
+//instantiation. Nothing here depends on WinRT, so the loops also run over test meshes.
+
+//Candidate edges of one chunk, weighted and classified, and the line vertices of the
+//edges above the threshold. Chunks depend only on the mesh and their lines are joined in
+//chunk order, so the output is the same on any number of cores.
+struct EdgeChunk
+{
+	explicit EdgeChunk(ScratchArena* arena) :
+		weightBatch(arena), aboveThreshold(arena), candidateRecords(arena), candidateVertices(arena),
+		pairedTriangles(arena), lines(arena) {}
+
+	EdgeWeightBatch weightBatch;
+	ScratchVector<unsigned char> aboveThreshold;
+	ScratchVector<unsigned int> candidateRecords;
+	ScratchVector<DirectX::XMFLOAT3> candidateVertices;
+	ScratchVector<unsigned int> pairedTriangles;
+	ScratchVector<DirectX::XMFLOAT3> lines;
+};
+
+//Whether two records of an EdgeAdjacency belong to the same edge.
+inline bool SameEdge(const EdgeAdjacency::Edge& a, const EdgeAdjacency::Edge& b)
+{
+	return a.vertices[0] == b.vertices[0] && a.vertices[1] == b.vertices[1];
+}
+
+//Output buffers are sized before a batch of candidates is looked at, so the per-pair
+//code below only reads references and stack arrays and never allocates.
+template <class Buffer>
+void ReserveGrowth(Buffer& buffer, size_t size)
+{
+	if (buffer.capacity() < size)
+		buffer.reserve(std::max(size, 2 * buffer.capacity()));
+}
+
+template <class Operator>
+void ClassifyChunk(EdgeChunk& chunk, float threshold)
+{
+	chunk.aboveThreshold.resize(chunk.weightBatch.Size());
+	chunk.weightBatch.Classify<Operator>(threshold, chunk.aboveThreshold.data());
+	chunk.lines.reserve(2 * std::count(chunk.aboveThreshold.begin(), chunk.aboveThreshold.end(), 1));
+}
+
+//Records [first, last) of the adjacency. No chunk may start inside the records of one
+//edge, so an edge already drawn for one pair of a non-manifold fan is not drawn for the
+//next. representative maps a welded vertex to an original one of the mesh.
+template <class Operator, class IndexType, class Representative>
+void ExtractAdjacentChunk(EdgeChunk& chunk, const ScratchVector<EdgeAdjacency::Edge>& edges, unsigned int first, unsigned int last,
+	const Triangle* triangles, const unsigned int* weldedIndices, const IndexType* indices, const MeshView& mesh,
+	const Representative& representative, float threshold)
+{
+	chunk.weightBatch.SetInputCount(Operator::INPUTS);
+	chunk.weightBatch.Reserve(last - first);
+	chunk.candidateRecords.reserve(last - first);
+	for (unsigned int record = first; record < last; record++) {
+		//Each record is one pair of triangles sharing an edge; boundary edges have no pair
+		const EdgeAdjacency::Edge& edge = edges[record];
+		if (edge.IsBoundary())
+			continue;
+		Operator::Add(chunk.weightBatch, AdjacentEdge<IndexType>(edge, triangles, weldedIndices, indices, mesh));
+		chunk.candidateRecords.push_back(record);
+	}
+	ClassifyChunk<Operator>(chunk, threshold);
+
+	unsigned int lastDrawn = EdgeAdjacency::NO_TRIANGLE;
+	for (unsigned int candidate = 0; candidate < chunk.candidateRecords.size(); candidate++) {
+		unsigned int record = chunk.candidateRecords[candidate];
+		if (chunk.aboveThreshold[candidate] && !(lastDrawn != EdgeAdjacency::NO_TRIANGLE && SameEdge(edges[lastDrawn], edges[record]))) {
+			chunk.lines.push_back(mesh.Position(representative(edges[record].vertices[0])));
+			chunk.lines.push_back(mesh.Position(representative(edges[record].vertices[1])));
+			lastDrawn = record;
+		}
+	}
+}
+
+//Half-edges [first, last) of a mesh built on welded indices. Each edge with a twin is
+//evaluated once, from its lower half-edge; edges without one have no pair of faces to
+//weigh. representative maps a welded vertex to an original one of the mesh.
+template <class Operator, class IndexType, class Representative>
+void ExtractHalfEdgeChunk(EdgeChunk& chunk, const HalfEdgeMesh& halfEdges, unsigned int first, unsigned int last,
+	const Triangle* triangles, const IndexType* indices, const MeshView& mesh, const Representative& representative, float threshold)
+{
+	chunk.weightBatch.SetInputCount(Operator::INPUTS);
+	chunk.weightBatch.Reserve(last - first);
+	chunk.candidateRecords.reserve(last - first);
+	for (unsigned int h = first; h < last; h++) {
+		unsigned int twin = halfEdges.Twin(h);
+		if (twin == HalfEdgeMesh::INVALID || twin < h)
+			continue;
+		Operator::Add(chunk.weightBatch, TwinEdge<IndexType>(h, halfEdges, triangles, indices, mesh));
+		chunk.candidateRecords.push_back(h);
+	}
+	ClassifyChunk<Operator>(chunk, threshold);
+
+	for (unsigned int candidate = 0; candidate < chunk.candidateRecords.size(); candidate++) {
+		if (chunk.aboveThreshold[candidate]) {
+			unsigned int h = chunk.candidateRecords[candidate];
+			chunk.lines.push_back(mesh.Position(representative(halfEdges.Origin(h))));
+			chunk.lines.push_back(mesh.Position(representative(halfEdges.Dest(h))));
+		}
+	}
+}
+
+//Normal of the vertex of triangle that is off the edge from a to b, as AdjacentEdge reads
+//it from the opposite corner. A triangle with no such vertex is degenerate and gives a
+//zero normal.
+inline DirectX::XMFLOAT3 OppositeNormal(const Triangle& triangle, const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b)
+{
+	for (int i = 0; i < 3; i++) {
+		if (triangle.triangleVertices[i] != a && triangle.triangleVertices[i] != b)
+			return triangle.triangleNormals[i];
+	}
+	return DirectX::XMFLOAT3(0.0f, 0.0f, 0.0f);
+}
+
+//Triangles [first, last) against the leaves search(triangle, spans) returns for them.
+//Every pair of triangles is evaluated once, from the triangle with the lower index. A
+//neighbour usually lies in the leaves of both shared vertices, so the neighbours already
+//paired with triangleA are remembered and skipped in the other leaves.
+template <class Operator, class Search>
+void ExtractSpatialChunk(EdgeChunk& chunk, const Triangle* triangles, unsigned int first, unsigned int last,
+	const Search& search, float threshold)
+{
+	Kdtree::IndexSpan localTriangles[3];
+	chunk.weightBatch.SetInputCount(Operator::INPUTS);
+	for (unsigned int indexA = first; indexA < last; indexA++) {
+		const Triangle& triangleA = triangles[indexA];
+		chunk.pairedTriangles.clear();
+		unsigned int leafCount = search(triangleA, localTriangles);
+		//Every candidate in the leaves can pair with triangleA at most once.
+		unsigned int candidateCount = 0;
+		for (unsigned int leaf = 0; leaf < leafCount; leaf++)
+			candidateCount += localTriangles[leaf].size();
+		ReserveGrowth(chunk.pairedTriangles, candidateCount);
+		ReserveGrowth(chunk.candidateVertices, chunk.candidateVertices.size() + 2 * candidateCount);
+		chunk.weightBatch.Reserve(chunk.weightBatch.Size() + candidateCount);
+
+		for (unsigned int leaf = 0; leaf < leafCount; leaf++) {
+			for (unsigned int index : localTriangles[leaf]) {
+				if (index <= indexA || std::find(chunk.pairedTriangles.begin(), chunk.pairedTriangles.end(), index) != chunk.pairedTriangles.end())
+					continue;
+				const Triangle& triangleB = triangles[index];
+				if (triangleA != triangleB) {
+					//Every vertex pair can match, and every vertex can add its normal
+					DirectX::XMFLOAT3 edgeVertices[9];
+					unsigned int edgeVertexCount = 0;
+
+					for (int i = 0; i < 3; i++) {
+						const DirectX::XMFLOAT3& A = triangleA.triangleVertices[i];
+						for (int j = 0; j < 3; j++) {
+							if (A == triangleB.triangleVertices[j]) {
+								edgeVertices[edgeVertexCount++] = A;
+							}
+						}
+					}
+
+					if (edgeVertexCount > 1) {
+						//The triangles have a shared edge, queue it for the edge weight
+						chunk.pairedTriangles.push_back(index);
+
+						DirectX::XMFLOAT3 oppositeNormals[2] = {
+							OppositeNormal(triangleA, edgeVertices[0], edgeVertices[1]),
+							OppositeNormal(triangleB, edgeVertices[0], edgeVertices[1]) };
+
+						Operator::Add(chunk.weightBatch, SpatialEdge(triangleA, triangleB, oppositeNormals));
+						chunk.candidateVertices.push_back(edgeVertices[0]);
+						chunk.candidateVertices.push_back(edgeVertices[1]);
+					}
+				}
+			}
+		}
+	}
+	ClassifyChunk<Operator>(chunk, threshold);
+
+	for (unsigned int candidate = 0; candidate < chunk.aboveThreshold.size(); candidate++) {
+		if (chunk.aboveThreshold[candidate]) {
+			chunk.lines.push_back(chunk.candidateVertices[2 * candidate]);
+			chunk.lines.push_back(chunk.candidateVertices[2 * candidate + 1]);
+		}
+	}
+}
@@ -0,0 +1,181 @@
+#pragma once
+
+#include "Triangle.h"
+#include "EdgeAdjacency.h"
+#include "HalfEdgeMesh.h"
+#include "EdgeWeightBatch.h"
+#include "MeshView.h"
+#include <cmath>
+
+//Edge operators are policy types for the extraction loops in EdgeExtraction.h, which are
+//instantiated once per operator. An operator declares INPUTS, the number of floats it
+//stores per candidate edge in the EdgeWeightBatch, and has four static steps:
+//
+//"Add": queues the inputs of one candidate edge, read through one of the views below
+//"Weigh": the weights of four edges from their inputs, one XMVECTOR per input
+//"Limit" and "Above": the threshold in the form Above compares against, computed once
+//per batch, and the mask of the four edges whose weight is above it
+//
+//WeighReference weighs one edge from its inputs with scalar code, for tests. A new
+//operator only needs such a type and a case in the per-mesh dispatch; the loops and the
+//batch stay as they are.
+
+//An edge record of EdgeAdjacency. Opposite corners are welded ids and are mapped back to
+//the original vertex of their own triangle, which carries that triangle's normal; the
+//normal is read straight from the mesh view. IndexType is the width of the mesh indices.
+template <class IndexType>
+class AdjacentEdge
+{
+public:
+	AdjacentEdge(const EdgeAdjacency::Edge& edge, const Triangle* triangles, const unsigned int* weldedIndices, const IndexType* indices, const MeshView& mesh) :
+		edge(edge), triangles(triangles), weldedIndices(weldedIndices), indices(indices), mesh(mesh) {}
+
+	const Triangle& GetTriangle(int side) const { return triangles[edge.triangles[side]]; }
+
+	DirectX::XMFLOAT3 GetOppositeNormal(int side) const
+	{
+		unsigned int corner = 3 * edge.triangles[side];
+		while (weldedIndices[corner] != edge.opposite[side])
+			corner++;
+		return mesh.Normal(indices[corner]);
+	}
+
+private:
+	const EdgeAdjacency::Edge& edge;
+	const Triangle* triangles;
+	const unsigned int* weldedIndices;
+	const IndexType* indices;
+	const MeshView& mesh;
+};
+
+//A half-edge of a HalfEdgeMesh together with its twin. Half-edge h starts at corner h of
+//the index buffer, so the corner opposite it is Prev(h) and its normal is read without
+//any search.
+template <class IndexType>
+class TwinEdge
+{
+public:
+	TwinEdge(unsigned int halfEdge, const HalfEdgeMesh& halfEdges, const Triangle* triangles, const IndexType* indices, const MeshView& mesh) :
+		triangles(triangles), indices(indices), mesh(mesh)
+	{
+		sides[0] = halfEdge;
+		sides[1] = halfEdges.Twin(halfEdge);
+	}
+
+	const Triangle& GetTriangle(int side) const { return triangles[HalfEdgeMesh::Face(sides[side])]; }
+	DirectX::XMFLOAT3 GetOppositeNormal(int side) const { return mesh.Normal(indices[HalfEdgeMesh::Prev(sides[side])]); }
+
+private:
+	unsigned int sides[2];
+	const Triangle* triangles;
+	const IndexType* indices;
+	const MeshView& mesh;
+};
+
+//Two triangles found to share vertex positions by a spatial search.
+class SpatialEdge
+{
+public:
+	SpatialEdge(const Triangle& triangleA, const Triangle& triangleB, const DirectX::XMFLOAT3* oppositeNormals) :
+		oppositeNormals(oppositeNormals)
+	{
+		triangles[0] = &triangleA;
+		triangles[1] = &triangleB;
+	}
+
+	const Triangle& GetTriangle(int side) const { return *triangles[side]; }
+	const DirectX::XMFLOAT3& GetOppositeNormal(int side) const { return oppositeNormals[side]; }
+
+private:
+	const Triangle* triangles[2];
+	const DirectX::XMFLOAT3* oppositeNormals;
+};
+
+//Weigh, classify and reference steps of operators whose inputs are two normals, a then
+//b, and whose weight is acos(dot(a, b)). With NORMALISE both normals are scaled to unit
+//length first and a zero normal gives pi / 2, as XMVector3Normalize does. XMVectorACos
+//is a degree 7 polynomial in |x| times sqrt(1 - |x|). Against double std::acos its error
+//over every float in [-1, 1] peaks at 4.4e-7 radians near x = -0.47, and
+//EdgeWeightBatchTest holds it to 5e-7 with a sweep. It is the same polynomial as
+//XMScalarACos, so for unit normals Weigh equals WeighReference. Normalising rounds the
+//dot product differently, which acos turns into about 2.5e-7 / sin(angle) radians of
+//difference, at most 1e-3 for parallel normals.
+template <bool NORMALISE>
+struct NormalAngleOperator
+{
+	static const unsigned int INPUTS = 6;
+
+	static DirectX::XMVECTOR XM_CALLCONV Cosines(const DirectX::XMVECTOR* inputs)
+	{
+		using namespace DirectX;
+		XMVECTOR dot = XMVectorMultiplyAdd(inputs[2], inputs[5], XMVectorMultiplyAdd(inputs[1], inputs[4], XMVectorMultiply(inputs[0], inputs[3])));
+		if (NORMALISE) {
+			XMVECTOR lengthSqA = XMVectorMultiplyAdd(inputs[2], inputs[2], XMVectorMultiplyAdd(inputs[1], inputs[1], XMVectorMultiply(inputs[0], inputs[0])));
+			XMVECTOR lengthSqB = XMVectorMultiplyAdd(inputs[5], inputs[5], XMVectorMultiplyAdd(inputs[4], inputs[4], XMVectorMultiply(inputs[3], inputs[3])));
+			XMVECTOR lengthSq = XMVectorMultiply(lengthSqA, lengthSqB);
+			XMVECTOR zero = XMVectorZero();
+			dot = XMVectorSelect(XMVectorMultiply(dot, XMVectorReciprocalSqrt(lengthSq)), zero, XMVectorEqual(lengthSq, zero));
+		}
+		return dot;
+	}
+
+	static DirectX::XMVECTOR XM_CALLCONV Weigh(const DirectX::XMVECTOR* inputs)
+	{
+		return DirectX::XMVectorACos(Cosines(inputs));
+	}
+
+	//acos falls monotonically from pi at -1 to 0 at 1, so an angle above the threshold is
+	//a cosine below cos(threshold). Thresholds outside [0, pi] have no such cosine: below
+	//0 every edge is above, from pi on none is. The two classifications only disagree on
+	//angles within the acos error of the threshold.
+	static DirectX::XMVECTOR XM_CALLCONV Limit(float threshold, EdgeWeightBatch::Classification mode)
+	{
+		if (mode == EdgeWeightBatch::ANGLE)
+			return DirectX::XMVectorReplicate(threshold);
+		if (threshold < 0.0f)
+			return DirectX::XMVectorReplicate(2.0f);
+		if (threshold >= DirectX::XM_PI)
+			return DirectX::XMVectorReplicate(-2.0f);
+		return DirectX::XMVectorReplicate(cosf(threshold));
+	}
+
+	static DirectX::XMVECTOR XM_CALLCONV Above(const DirectX::XMVECTOR* inputs, DirectX::FXMVECTOR limit, EdgeWeightBatch::Classification mode)
+	{
+		DirectX::XMVECTOR cosines = Cosines(inputs);
+		if (mode == EdgeWeightBatch::COSINE)
+			return DirectX::XMVectorLess(cosines, limit);
+		return DirectX::XMVectorGreater(DirectX::XMVectorACos(cosines), limit);
+	}
+
+	//XMVector3Normalize and XMScalarACos on one pair, as the per edge weight functions do.
+	static float WeighReference(const float* inputs)
+	{
+		DirectX::XMVECTOR a = DirectX::XMVectorSet(inputs[0], inputs[1], inputs[2], 0.0f);
+		DirectX::XMVECTOR b = DirectX::XMVectorSet(inputs[3], inputs[4], inputs[5], 0.0f);
+		if (NORMALISE) {
+			a = DirectX::XMVector3Normalize(a);
+			b = DirectX::XMVector3Normalize(b);
+		}
+		return DirectX::XMScalarACos(DirectX::XMVectorGetX(DirectX::XMVector3Dot(a, b)));
+	}
+};
+
+//Angle between the face normals, which are cached unit length.
+struct SODOperator : NormalAngleOperator<false>
+{
+	template <class EdgeView>
+	static void Add(EdgeWeightBatch& batch, const EdgeView& edge)
+	{
+		batch.Add(edge.GetTriangle(0).faceNormal, edge.GetTriangle(1).faceNormal);
+	}
+};
+
+//Angle between the normals of the two vertices off the shared edge.
+struct ESODOperator : NormalAngleOperator<true>
+{
+	template <class EdgeView>
+	static void Add(EdgeWeightBatch& batch, const EdgeView& edge)
+	{
+		batch.Add(edge.GetOppositeNormal(0), edge.GetOppositeNormal(1));
+	}
+};
@@ -37,19 +37,19 @@ void EdgeRenderer::Update(Windows::Perception::Spatial::SpatialCoordinateSystem
 	}
 }
 
-void EdgeRenderer::CreateBuffer(std::vector<DirectX::XMFLOAT3>* vertices, Windows::Perception::Spatial::SpatialCoordinateSystem^ modelCoord) {
+void EdgeRenderer::CreateBuffer(const DirectX::XMFLOAT3* vertices, unsigned int vertexCount, Windows::Perception::Spatial::SpatialCoordinateSystem^ modelCoord) {
 	vertexMutex.lock();
 	buffersReady = false;
 	auto device = deviceResources->GetD3DDevice();
 
 	EdgeVertexCollection newCollection = EdgeVertexCollection();
 	newCollection.coord = modelCoord;
-	newCollection.numVertices = vertices->size();
+	newCollection.numVertices = vertexCount;
 
 	D3D11_BUFFER_DESC vBufferDesc;
 	ZeroMemory(&vBufferDesc, sizeof(vBufferDesc));
 	vBufferDesc.Usage = D3D11_USAGE_DEFAULT;
-	vBufferDesc.ByteWidth = sizeof(DirectX::XMFLOAT3) * vertices->size();
+	vBufferDesc.ByteWidth = sizeof(DirectX::XMFLOAT3) * vertexCount;
 	vBufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
 	vBufferDesc.CPUAccessFlags = 0;
 	vBufferDesc.MiscFlags = 0;
@@ -57,7 +57,7 @@ void EdgeRenderer::CreateBuffer(std::vector<DirectX::XMFLOAT3>* vertices, Window
 
 	D3D11_SUBRESOURCE_DATA vBufferData;
 	ZeroMemory(&vBufferData, sizeof(vBufferData));
-	vBufferData.pSysMem = vertices->data();
+	vBufferData.pSysMem = vertices;
 	vBufferData.SysMemPitch = 0;
 	vBufferData.SysMemSlicePitch = 0;
 
@@ -15,7 +15,7 @@ public:
 	EdgeRenderer::EdgeRenderer(const std::shared_ptr<DX::DeviceResources>& deviceResources);
 	void EdgeRenderer::Render(bool isStereo);
 	void EdgeRenderer::Update(Windows::Perception::Spatial::SpatialCoordinateSystem^ coordinateSystem);
-	void EdgeRenderer::CreateBuffer(std::vector<DirectX::XMFLOAT3>* vertices, Windows::Perception::Spatial::SpatialCoordinateSystem^ modelCoord);
+	void EdgeRenderer::CreateBuffer(const DirectX::XMFLOAT3* vertices, unsigned int vertexCount, Windows::Perception::Spatial::SpatialCoordinateSystem^ modelCoord);
 	void EdgeRenderer::CreateDeviceDependentResources();
 	void EdgeRenderer::ReleaseDeviceDependentResources();
 
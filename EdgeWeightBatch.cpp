@@ -0,0 +1,67 @@
+#include "pch.h"
+#include "EdgeWeightBatch.h"
+#include <algorithm>
+
+using namespace DirectX;
+
+void EdgeWeightBatch::SetInputCount(unsigned int count)
+{
+	//The rows are laid out again over the same storage.
+	inputCount = count;
+	capacity = (unsigned int)(inputs.size() / count);
+	size = 0;
+}
+
+void EdgeWeightBatch::Add(const float* values)
+{
+	if (size == capacity) {
+		Reserve(size + 1);
+	}
+	for (unsigned int input = 0; input < inputCount; input++) {
+		inputs[input * capacity + size] = values[input];
+	}
+	size++;
+}
+
+void EdgeWeightBatch::Add(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+	const float values[6] = { a.x, a.y, a.z, b.x, b.y, b.z };
+	Add(values);
+}
+
+void EdgeWeightBatch::Reserve(unsigned int count)
+{
+	if (capacity >= count) {
+		return;
+	}
+	unsigned int grown = std::max(count, 2 * capacity);
+	ScratchVector<float> rows(inputCount * grown, 0.0f, inputs.get_allocator());
+	for (unsigned int input = 0; input < inputCount; input++) {
+		std::copy(inputs.begin() + input * capacity, inputs.begin() + input * capacity + size, rows.begin() + input * grown);
+	}
+	inputs.swap(rows);
+	capacity = grown;
+}
+
+void EdgeWeightBatch::Load(unsigned int first, unsigned int count, XMVECTOR* lanes) const
+{
+	for (unsigned int input = 0; input < count; input++) {
+		const float* row = inputs.data() + input * capacity;
+		if (first + 4 <= size) {
+			lanes[input] = XMLoadFloat4((const XMFLOAT4*)&row[first]);
+		} else {
+			float padded[4];
+			for (unsigned int lane = 0; lane < 4; lane++) {
+				padded[lane] = row[std::min(first + lane, size - 1)];
+			}
+			lanes[input] = XMLoadFloat4((const XMFLOAT4*)padded);
+		}
+	}
+}
+
+void EdgeWeightBatch::Get(unsigned int edge, float* values) const
+{
+	for (unsigned int input = 0; input < inputCount; input++) {
+		values[input] = inputs[input * capacity + edge];
+	}
+}
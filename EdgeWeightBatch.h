@@ -0,0 +1,108 @@
+#pragma once
+
+#include "ScratchArena.h"
+#include <DirectXMath.h>
+
+//Per edge inputs of an edge operator for many edges at once. Every input is kept as its
+//own float array, so a single XMVECTOR holds the same input of four edges and the weight
+//and classify steps of the operator run on SSE or NEON without any shuffling. The
+//operator declares how many inputs an edge has and what they mean (see EdgeOperators.h);
+//the batch only stores them and runs the operator over them four edges at a time.
+class EdgeWeightBatch
+{
+public:
+	//How operators that weigh an angle compare it against the threshold:
+	//
+	//"ANGLE": the angle of every edge against the threshold angle
+	//"COSINE": the cosine of every edge against cos(threshold), without any acos
+	enum Classification { ANGLE, COSINE };
+
+	explicit EdgeWeightBatch(ScratchArena* arena = nullptr) : inputs(arena) {}
+
+	//Sets the number of inputs per edge and empties the batch, keeping its storage.
+	void SetInputCount(unsigned int count);
+	unsigned int InputCount() const { return inputCount; }
+
+	void Clear() { size = 0; }
+	//Adds one edge from InputCount values, or from two vectors as six inputs.
+	void Add(const float* values);
+	void Add(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b);
+	//Makes room for count edges in total, at least doubling the capacity when it grows, so
+	//Adds up to that size do not allocate.
+	void Reserve(unsigned int count);
+	unsigned int Size() const { return size; }
+
+	void SetClassification(Classification mode) { classification = mode; }
+
+	//The first count inputs of the four edges from first on, one XMVECTOR per input. Lanes
+	//past the last edge repeat it, so the operator never sees values it did not add.
+	void Load(unsigned int first, unsigned int count, DirectX::XMVECTOR* lanes) const;
+	//The inputs of one edge.
+	void Get(unsigned int edge, float* values) const;
+
+	//Writes the weight of every edge to weights, four edges per step of Operator::Weigh.
+	template <class Operator>
+	void Compute(float* weights) const;
+
+	//Sets aboveThreshold[i] to whether the weight of edge i is larger than threshold, as
+	//Operator::Above decides it under the classification set on the batch.
+	template <class Operator>
+	void Classify(float threshold, unsigned char* aboveThreshold) const;
+
+	//One edge at a time with Operator::WeighReference, as the per edge weight functions do.
+	template <class Operator>
+	void ComputeReference(float* weights) const;
+
+private:
+	Classification classification = COSINE;
+
+	//inputCount rows of capacity floats, one row per input.
+	ScratchVector<float> inputs;
+	unsigned int inputCount = 6;
+	unsigned int size = 0;
+	unsigned int capacity = 0;
+};
+
+template <class Operator>
+void EdgeWeightBatch::Compute(float* weights) const
+{
+	DirectX::XMVECTOR lanes[Operator::INPUTS];
+	for (unsigned int i = 0; i < size; i += 4) {
+		Load(i, Operator::INPUTS, lanes);
+		DirectX::XMVECTOR edgeWeights = Operator::Weigh(lanes);
+		if (i + 4 <= size) {
+			DirectX::XMStoreFloat4((DirectX::XMFLOAT4*)&weights[i], edgeWeights);
+		} else {
+			float tail[4];
+			DirectX::XMStoreFloat4((DirectX::XMFLOAT4*)tail, edgeWeights);
+			for (unsigned int lane = 0; i + lane < size; lane++) {
+				weights[i + lane] = tail[lane];
+			}
+		}
+	}
+}
+
+template <class Operator>
+void EdgeWeightBatch::Classify(float threshold, unsigned char* aboveThreshold) const
+{
+	DirectX::XMVECTOR limit = Operator::Limit(threshold, classification);
+	DirectX::XMVECTOR lanes[Operator::INPUTS];
+	for (unsigned int i = 0; i < size; i += 4) {
+		Load(i, Operator::INPUTS, lanes);
+		uint32_t mask[4];
+		DirectX::XMStoreInt4(mask, Operator::Above(lanes, limit, classification));
+		for (unsigned int lane = 0; lane < 4 && i + lane < size; lane++) {
+			aboveThreshold[i + lane] = mask[lane] != 0;
+		}
+	}
+}
+
+template <class Operator>
+void EdgeWeightBatch::ComputeReference(float* weights) const
+{
+	float values[Operator::INPUTS];
+	for (unsigned int i = 0; i < size; i++) {
+		Get(i, values);
+		weights[i] = Operator::WeighReference(values);
+	}
+}
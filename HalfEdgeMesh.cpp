@@ -0,0 +1,99 @@
+#include "pch.h"
+#include "HalfEdgeMesh.h"
+#include "IndexStorage.h"
+
+const unsigned int HalfEdgeMesh::INVALID;
+
+void HalfEdgeMesh::Build(const unsigned int* indices, unsigned int triangleCount, unsigned int vertexCount)
+{
+	unsigned int halfEdgeCount = 3 * triangleCount;
+	origins.assign(indices, indices + halfEdgeCount);
+	twins.assign(halfEdgeCount, INVALID);
+	boundaryHalfEdges = 0;
+	nonManifoldEdges = 0;
+
+	//Gather the half-edges of every undirected edge in an open-addressing table keyed by
+	//the sorted vertex pair. Only the first two are kept; the count tells the rest.
+	unsigned int tableMask = HashTableMask(2 * halfEdgeCount);
+	Slot empty = { INVALID, INVALID, 0 };
+	table.assign(tableMask + 1, empty);
+
+	for (unsigned int h = 0; h < halfEdgeCount; h++) {
+		unsigned int a = Origin(h);
+		unsigned int b = Dest(h);
+		if (a == b) {
+			continue;
+		}
+		if (b < a) {
+			std::swap(a, b);
+		}
+		unsigned long long key = ((unsigned long long)a << 32) | b;
+		unsigned int slot = HashSlot(key, tableMask);
+		for (;;) {
+			Slot& entry = table[slot];
+			if (entry.count == 0) {
+				entry.first = h;
+				entry.count = 1;
+				break;
+			}
+			unsigned int c = Origin(entry.first);
+			unsigned int d = Dest(entry.first);
+			if (std::min(c, d) == a && std::max(c, d) == b) {
+				if (entry.count++ == 1) {
+					entry.second = h;
+				}
+				break;
+			}
+			slot = (slot + 1) & tableMask;
+		}
+	}
+
+	for (const Slot& entry : table) {
+		if (entry.count < 2) {
+			continue;
+		}
+		if (entry.count == 2 && Origin(entry.first) == Dest(entry.second)) {
+			twins[entry.first] = entry.second;
+			twins[entry.second] = entry.first;
+		} else {
+			nonManifoldEdges++;
+		}
+	}
+	for (unsigned int twin : twins) {
+		if (twin == INVALID) {
+			boundaryHalfEdges++;
+		}
+	}
+
+	//Counting sort of the half-edges by origin. Offsets first hold the end of each
+	//vertex's run, and filling backwards moves them to the start.
+	vertexOffsets.assign(vertexCount + 1, 0);
+	for (unsigned int h = 0; h < halfEdgeCount; h++) {
+		vertexOffsets[origins[h]]++;
+	}
+	for (unsigned int v = 1; v <= vertexCount; v++) {
+		vertexOffsets[v] += vertexOffsets[v - 1];
+	}
+	vertexOutgoing.resize(halfEdgeCount);
+	for (unsigned int h = halfEdgeCount; h-- > 0;) {
+		vertexOutgoing[--vertexOffsets[origins[h]]] = h;
+	}
+	vertexOffsets[vertexCount] = halfEdgeCount;
+}
+
+HalfEdgeMesh::HalfEdgeSpan HalfEdgeMesh::Outgoing(unsigned int vertex) const
+{
+	const unsigned int* first = vertexOutgoing.data();
+	HalfEdgeSpan span = { first + vertexOffsets[vertex], first + vertexOffsets[vertex + 1] };
+	return span;
+}
+
+bool HalfEdgeMesh::IsBoundaryVertex(unsigned int vertex) const
+{
+	for (unsigned int h : Outgoing(vertex)) {
+		if (IsBoundary(h) || IsBoundary(Prev(h))) {
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include "ScratchArena.h"
+#include <algorithm>
+
+//Half-edge connectivity of a triangle index buffer, stored as parallel arrays of 32-bit
+//indices. Half-edge h belongs to face h / 3 and runs from corner h % 3 to the next corner,
+//so next, prev and face are arithmetic and only origins and twins are stored.
+//
+//Two half-edges become twins only when they are the sole two on an undirected edge and
+//run in opposite directions. Boundary edges, edges shared by three or more faces and
+//edges of inconsistently wound neighbours keep INVALID twins, so the mesh is always
+//traversable. The outgoing half-edges of every vertex are also kept in one packed array,
+//which covers every fan of a non-manifold vertex. None of the iteration allocates, and
+//all storage comes from the arena passed in, if any.
+class HalfEdgeMesh
+{
+public:
+	static const unsigned int INVALID = 0xFFFFFFFF;
+
+	struct HalfEdgeSpan
+	{
+		const unsigned int* first;
+		const unsigned int* last;
+
+		const unsigned int* begin() const { return first; }
+		const unsigned int* end() const { return last; }
+		unsigned int size() const { return (unsigned int)(last - first); }
+	};
+
+	explicit HalfEdgeMesh(ScratchArena* arena = nullptr) :
+		origins(arena), twins(arena), vertexOffsets(arena), vertexOutgoing(arena), table(arena) {}
+
+	//Linear in the number of triangles. Indices must be below vertexCount.
+	void Build(const unsigned int* indices, unsigned int triangleCount, unsigned int vertexCount);
+
+	unsigned int FaceCount() const { return (unsigned int)origins.size() / 3; }
+	unsigned int HalfEdgeCount() const { return (unsigned int)origins.size(); }
+	unsigned int VertexCount() const { return (unsigned int)vertexOffsets.size() - 1; }
+	unsigned int BoundaryHalfEdgeCount() const { return boundaryHalfEdges; }
+	unsigned int NonManifoldEdgeCount() const { return nonManifoldEdges; }
+
+	static unsigned int Face(unsigned int h) { return h / 3; }
+	static unsigned int Next(unsigned int h) { return h % 3 == 2 ? h - 2 : h + 1; }
+	static unsigned int Prev(unsigned int h) { return h % 3 == 0 ? h + 2 : h - 1; }
+	static unsigned int FaceHalfEdge(unsigned int face) { return 3 * face; }
+
+	unsigned int Origin(unsigned int h) const { return origins[h]; }
+	unsigned int Dest(unsigned int h) const { return origins[Next(h)]; }
+	unsigned int Twin(unsigned int h) const { return twins[h]; }
+	bool IsBoundary(unsigned int h) const { return twins[h] == INVALID; }
+
+	//Next outgoing half-edge of the same vertex, turning across the incoming edge of this
+	//face. INVALID when that edge has no twin.
+	unsigned int RotateOutgoing(unsigned int h) const { return twins[Prev(h)]; }
+
+	//Every half-edge leaving the vertex, one per incident face, in no particular order.
+	HalfEdgeSpan Outgoing(unsigned int vertex) const;
+	bool IsBoundaryVertex(unsigned int vertex) const;
+
+	//Calls f(face) once for every face around the vertex.
+	template <typename F> void ForEachFace(unsigned int vertex, F f) const
+	{
+		for (unsigned int h : Outgoing(vertex)) {
+			f(Face(h));
+		}
+	}
+
+	//Calls f(neighbour) for every vertex sharing an edge with the vertex. Each outgoing
+	//half-edge reports its destination, and an incoming half-edge without a twin its
+	//origin, so a manifold, consistently wound neighbourhood reports each neighbour once.
+	//Across an edge that has faces but no twins, because it is non-manifold or its two
+	//faces are wound inconsistently, the neighbour is reported once per face on the edge.
+	template <typename F> void ForEachOneRing(unsigned int vertex, F f) const
+	{
+		for (unsigned int h : Outgoing(vertex)) {
+			f(Dest(h));
+			unsigned int incoming = Prev(h);
+			if (IsBoundary(incoming)) {
+				f(Origin(incoming));
+			}
+		}
+	}
+
+private:
+	//The half-edges of one undirected edge while building: the first two and how many.
+	struct Slot
+	{
+		unsigned int first;
+		unsigned int second;
+		unsigned int count;
+	};
+
+	ScratchVector<unsigned int> origins;
+	ScratchVector<unsigned int> twins;
+	ScratchVector<unsigned int> vertexOffsets;
+	ScratchVector<unsigned int> vertexOutgoing;
+	ScratchVector<Slot> table;
+
+	unsigned int boundaryHalfEdges = 0;
+	unsigned int nonManifoldEdges = 0;
+};
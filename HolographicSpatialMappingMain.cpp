@@ -36,6 +36,47 @@ using namespace Windows::Perception::Spatial::Surfaces;
 using namespace Windows::UI::Input::Spatial;
 using namespace std::placeholders;
 
+//The surface buffer formats MeshView reads. The device may deliver any format listed in
+//the Supported*Formats of the mesh options, so the rest map to UNSUPPORTED rather than
+//being read as floats.
+static MeshView::PositionFormat GetPositionFormat(DirectXPixelFormat format)
+{
+	switch (format) {
+	case DirectXPixelFormat::R16G16B16A16IntNormalized:
+		return MeshView::POSITION_SNORM16;
+	case DirectXPixelFormat::R32G32B32A32Float:
+	case DirectXPixelFormat::R32G32B32Float:
+		return MeshView::POSITION_FLOAT32;
+	default:
+		return MeshView::POSITION_UNSUPPORTED;
+	}
+}
+
+static MeshView::NormalFormat GetNormalFormat(DirectXPixelFormat format)
+{
+	switch (format) {
+	case DirectXPixelFormat::R8G8B8A8IntNormalized:
+		return MeshView::NORMAL_SNORM8;
+	case DirectXPixelFormat::R32G32B32A32Float:
+	case DirectXPixelFormat::R32G32B32Float:
+		return MeshView::NORMAL_FLOAT32;
+	default:
+		return MeshView::NORMAL_UNSUPPORTED;
+	}
+}
+
+static MeshView::IndexFormat GetIndexFormat(DirectXPixelFormat format)
+{
+	switch (format) {
+	case DirectXPixelFormat::R16UInt:
+		return MeshView::INDEX_UINT16;
+	case DirectXPixelFormat::R32UInt:
+		return MeshView::INDEX_UINT32;
+	default:
+		return MeshView::INDEX_UNSUPPORTED;
+	}
+}
+
 // Loads and initializes application assets when the application is loaded.
 HolographicSpatialMappingMain::HolographicSpatialMappingMain(
 	const std::shared_ptr<DX::DeviceResources>& deviceResources) :
@@ -239,180 +280,226 @@ void HolographicSpatialMappingMain::newSurfaces(SpatialSurfaceObserver^ sender,
 	return;
 }
 
-bool operator== (const DirectX::XMFLOAT3 A, const DirectX::XMFLOAT3 B) {
-	if (A.x == B.x &&
-		A.y == B.y &&
-		A.z == B.z)
-	{
-		return true;
-	}
-	return false;
-}
-bool operator!= (const DirectX::XMFLOAT3 A, const DirectX::XMFLOAT3 B) {
-	if (A.x != B.x ||
-		A.y != B.y ||
-		A.z != B.z)
-	{
-		return true;
-	}
-	return false;
-}
-bool operator!= (const Triangle A, const Triangle B) {
-	for (unsigned int i = 0; i < 3; i++) {
-		if (A.triangleVertices[i] != B.triangleVertices[i]) {
-			return true;
-		}
-	}
-	return false;
-}
-
 void HolographicSpatialMapping::HolographicSpatialMappingMain::PopulateEdgeList(
 	Windows::Perception::Spatial::Surfaces::SpatialSurfaceMesh^ mesh
 ) {
 	clock_t timer;
 	timer = clock();
 
-	std::vector<UINT> indexData;
-	std::vector<DirectX::XMFLOAT3> vertexData;
-	std::vector<DirectX::XMFLOAT3> vertexNormalsData;
-
-	std::vector<Triangle> meshTriangles;
-
-	DirectX::PackedVector::XMSHORTN4* rawVertexData = (DirectX::PackedVector::XMSHORTN4*)GetDataFromIBuffer(mesh->VertexPositions->Data);
-	auto vertexScale = mesh->VertexPositionScale;
-	unsigned int InputVertexCount = mesh->VertexPositions->ElementCount;
-
-	for (unsigned int index = 0; index < InputVertexCount; index++)
-	{
-		// read the currentPos as an XMSHORTN4. 
-		DirectX::PackedVector::XMSHORTN4 currentPos = DirectX::PackedVector::XMSHORTN4(rawVertexData[index]);
-
-		DirectX::XMFLOAT4 xmfloat;
-
-		// XMVECTOR knows how to convert the XMSHORTN4 to actual floating point coordinates. 
-		DirectX::XMVECTOR xmvec = XMLoadShortN4(&currentPos);
+	//Everything below is scratch for this surface and comes from an arena leased for the
+	//call, which is reset when the lease ends. It is declared first so it outlives the
+	//structures using it.
+	ScratchArenaPool::Lease scratch(scratchArenas);
+	ScratchArena* arena = scratch.Get();
 
-		// STore that into an XMFLOAT4 so we can read the values.
-		DirectX::XMStoreFloat4(&xmfloat, xmvec);
+	ScratchVector<UINT> indexData(arena);
+	ScratchVector<DirectX::XMFLOAT3> vertexData(arena);
+	ScratchVector<DirectX::XMFLOAT3> vertexNormalsData(arena);
 
-		DirectX::XMFLOAT4 scaledVector = DirectX::XMFLOAT4(xmfloat.x*vertexScale.x, xmfloat.y*vertexScale.y, xmfloat.z*vertexScale.z, xmfloat.w);
+	ScratchVector<Triangle> meshTriangles(arena);
 
-		vertexData.push_back(DirectX::XMFLOAT3(scaledVector.x, scaledVector.y, scaledVector.z));
+	//The device buffers are read in place; only what a path needs is decoded into the
+	//vectors above.
+	MeshView view = MeshView();
+	SpatialSurfaceMeshBuffer^ positionBuffer = mesh->VertexPositions;
+	SpatialSurfaceMeshBuffer^ normalBuffer = mesh->VertexNormals;
+	SpatialSurfaceMeshBuffer^ indexBuffer = mesh->TriangleIndices;
+	auto vertexScale = mesh->VertexPositionScale;
+	view.SetPositions(GetDataFromIBuffer(positionBuffer->Data), positionBuffer->ElementCount, positionBuffer->Stride,
+		GetPositionFormat(positionBuffer->Format), DirectX::XMFLOAT3(vertexScale.x, vertexScale.y, vertexScale.z));
+	view.SetNormals(GetDataFromIBuffer(normalBuffer->Data), normalBuffer->ElementCount, normalBuffer->Stride,
+		GetNormalFormat(normalBuffer->Format));
+	view.SetIndices(GetDataFromIBuffer(indexBuffer->Data), indexBuffer->ElementCount,
+		GetIndexFormat(indexBuffer->Format));
+	if (!view.IsSupported()) {
+		char buffer[255];
+		sprintf_s(buffer, 255, "Skipped a surface with buffer formats %d, %d, %d.\n",
+			(int)positionBuffer->Format, (int)normalBuffer->Format, (int)indexBuffer->Format);
+		OutputDebugStringA(buffer);
+		return;
 	}
+	unsigned int InputVertexCount = view.VertexCount();
+
+	//Triangles are only needed for the spatial searches and the SOD face normals. The
+	//adjacency paths work on the view and decode just the normals and positions they read.
+	//Float positions have no packed key, so they are welded on the decoded positions,
+	//exactly on their bits while weldEpsilon is 0.
+	bool indexAdjacency = neighbourIndex == EDGE_ADJACENCY || neighbourIndex == HALF_EDGE;
+	bool needsTriangles = !indexAdjacency || mode == SOD;
+	bool decodedWeld = indexAdjacency && (weldEpsilon > 0.0f || !view.PackedPositions());
+#ifdef MATLAB_DATA
+	bool needsVertexData = true;
+	bool needsIndexData = true;
+#else
+	bool needsVertexData = needsTriangles || decodedWeld;
+	bool needsIndexData = needsTriangles;
+#endif
 
-	DirectX::PackedVector::XMBYTEN4* rawNormalData = (DirectX::PackedVector::XMBYTEN4*)GetDataFromIBuffer(mesh->VertexNormals->Data);
-	unsigned int InputNormalsCount = mesh->VertexNormals->ElementCount;
-
-	for (unsigned int index = 0; index < InputNormalsCount; index++)
-	{
-		// read the currentPos as an XMSHORTN4. 
-		DirectX::PackedVector::XMBYTEN4 currentPos = DirectX::PackedVector::XMBYTEN4(rawNormalData[index]);
-		DirectX::XMFLOAT4 xmfloat;
-
-		// XMVECTOR knows how to convert the XMSHORTN4 to actual floating point coordinates. 
-		DirectX::XMVECTOR xmvec = DirectX::PackedVector::XMLoadByteN4(&currentPos);
-
-		// STore that into an XMFLOAT4 so we can read the values.
-		DirectX::XMStoreFloat4(&xmfloat, xmvec);
-
-		// Which need to be scaled by the vertex scale.
-		DirectX::XMFLOAT4 scaledVector = DirectX::XMFLOAT4(xmfloat.x, xmfloat.y, xmfloat.z, xmfloat.w);
-
-		vertexNormalsData.push_back(DirectX::XMFLOAT3(scaledVector.x, scaledVector.y, scaledVector.z));
+	if (needsVertexData) {
+		vertexData.resize(InputVertexCount);
+		vertexNormalsData.resize(view.NormalCount());
+		if (view.PackedPositions()) {
+			DecodePositions(view.PackedPositions(), InputVertexCount, DirectX::XMFLOAT3(vertexScale.x, vertexScale.y, vertexScale.z), vertexData.data());
+		} else {
+			for (unsigned int index = 0; index < InputVertexCount; index++)
+				vertexData[index] = view.Position(index);
+		}
+		if (view.PackedNormals()) {
+			DecodeNormals(view.PackedNormals(), view.NormalCount(), vertexNormalsData.data());
+		} else {
+			for (unsigned int index = 0; index < view.NormalCount(); index++)
+				vertexNormalsData[index] = view.Normal(index);
+		}
 	}
 
-	DirectX::PackedVector::XMUSHORT4* rawIndexData = (DirectX::PackedVector::XMUSHORT4*)GetDataFromIBuffer(mesh->TriangleIndices->Data);
-	unsigned int InputIndexCount = mesh->TriangleIndices->ElementCount / 4;
-	for (unsigned int index = 0; index < InputIndexCount; index++)
-	{
-		// read the currentPos as an XMSHORTN4.
-		//DirectX::XMUINT4 currentPos = DirectX::XMUINT4(rawIndexData[index]);
-		DirectX::PackedVector::XMUSHORT4 currentPos = (DirectX::PackedVector::XMUSHORT4)rawIndexData[index];
-		DirectX::XMUINT4 xmfloat;
-
-		// XMVECTOR knows how to convert the XMSHORTN4 to actual floating point coordinates. 
-		DirectX::XMVECTOR xmvec = DirectX::PackedVector::XMLoadUShort4(&currentPos);
-
-		// STore that into an XMFLOAT4 so we can read the values.
-		DirectX::XMStoreUInt4(&xmfloat, xmvec);
-
-		// Which need to be scaled by the vertex scale.
-		//DirectX::PackedVector::XMUSHORT4 scaledVector = DirectX::PackedVector::XMUSHORT4(xmfloat.x, xmfloat.y, xmfloat.z, xmfloat.w);
-		//indexData.push_back(DirectX::XMUINT3(xmfloat.x, xmfloat.y, xmfloat.z));
-
-		indexData.push_back(xmfloat.x);
-		indexData.push_back(xmfloat.y);
-		indexData.push_back(xmfloat.z);
-		indexData.push_back(xmfloat.w);
+	if (needsIndexData) {
+		indexData.resize(view.IndexCount());
+		if (view.GetIndexFormat() == MeshView::INDEX_UINT16)
+			DecodeIndices(view.GetIndices<unsigned short>(), view.IndexCount(), indexData.data());
+		else
+			DecodeIndices(view.GetIndices<unsigned int>(), view.IndexCount(), indexData.data());
 	}
 
 	//Construct triangles
-	for (std::vector<UINT>::iterator it = indexData.begin(); it != indexData.end() && it + 1 != indexData.end() && it + 2 != indexData.end(); it += 3) {
-		meshTriangles.push_back(Triangle(vertexData[*it], vertexData[*(it + 1)], vertexData[*(it + 2)],
-			vertexNormalsData[*it], vertexNormalsData[*(it + 1)], vertexNormalsData[*(it + 2)]));
+	unsigned int triangleCount = view.TriangleCount();
+	if (needsTriangles) {
+		meshTriangles.reserve(triangleCount);
+		for (ScratchVector<UINT>::iterator it = indexData.begin(); it != indexData.end() && it + 1 != indexData.end() && it + 2 != indexData.end(); it += 3) {
+			meshTriangles.push_back(Triangle(vertexData[*it], vertexData[*(it + 1)], vertexData[*(it + 2)],
+				vertexNormalsData[*it], vertexNormalsData[*(it + 1)], vertexNormalsData[*(it + 2)]));
+		}
 	}
 
-	Kdtree tree = Kdtree();
-	Kdtree::Node* rootNode = tree.Create(meshTriangles, 0, 100);
-	for (Triangle triangle : meshTriangles) {
-		tree.Insert(triangle, rootNode);
+	Kdtree tree(arena);
+	SpatialGrid grid = SpatialGrid(arena);
+	EdgeAdjacency adjacency = EdgeAdjacency(arena);
+	HalfEdgeMesh halfEdges = HalfEdgeMesh(arena);
+	QuantizedWeld weld = QuantizedWeld(arena);
+	VertexWeld tolerantWeld = VertexWeld(arena);
+	ScratchVector<UINT> weldedIndices(arena);
+	unsigned int mergedVertices = 0;
+	Kdtree::NodeIndex rootNode = Kdtree::ROOT;
+	auto remapIndices = [&](const auto& vertexWeld, const auto* indices) {
+		for (unsigned int corner = 0; corner < 3 * triangleCount; corner++)
+			weldedIndices[corner] = vertexWeld.Welded(indices[corner]);
+	};
+	auto remapAnyIndices = [&](const auto& vertexWeld) {
+		if (view.GetIndexFormat() == MeshView::INDEX_UINT16)
+			remapIndices(vertexWeld, view.GetIndices<unsigned short>());
+		else
+			remapIndices(vertexWeld, view.GetIndices<unsigned int>());
+	};
+	switch (neighbourIndex) {
+	case EDGE_ADJACENCY:
+	case HALF_EDGE:
+		//Vertices split by the device are joined first: exactly on the raw positions, or
+		//within weldEpsilon on the decoded ones
+		weldedIndices.resize(3 * triangleCount);
+		if (decodedWeld) {
+			tolerantWeld.Build(vertexData.data(), InputVertexCount, weldEpsilon);
+			remapAnyIndices(tolerantWeld);
+			mergedVertices = tolerantWeld.MergedCount();
+		} else {
+			weld.Build(view.PackedPositions(), InputVertexCount);
+			remapAnyIndices(weld);
+			mergedVertices = weld.MergedCount();
+		}
+		if (neighbourIndex == HALF_EDGE)
+			halfEdges.Build(weldedIndices.data(), triangleCount, InputVertexCount - mergedVertices);
+		else
+			adjacency.Build(weldedIndices.data(), triangleCount);
+		break;
+	case KDTREE:
+		rootNode = tree.Create(meshTriangles, 0, 100);
+		tree.InsertAll(rootNode);
+		break;
+	case HASH_GRID:
+		grid.Create(meshTriangles);
+		grid.InsertAll();
+		break;
 	}
 
-	std::vector<DirectX::XMFLOAT3> edgeVertices;
-	std::vector<DirectX::XMFLOAT3> neighbourNormals;
-	std::vector<Triangle> localTriangles;
+	//Candidate edges are gathered, weighted and classified in chunks on the thread pool.
+	const unsigned int chunkSize = 4096;
+	ScratchVector<EdgeChunk> chunks(arena);
+	ScratchVector<unsigned int> chunkStarts(arena);
 
 	//Populate edgelist
-	std::vector<DirectX::XMFLOAT3> vertexPositions;
+	ScratchVector<DirectX::XMFLOAT3> vertexPositions(arena);
 	Windows::Perception::Spatial::SpatialCoordinateSystem^ modelCoord = mesh->CoordinateSystem;
-	
-	for (Triangle triangleA : meshTriangles) {
-		//localTriangles = tree.SearchPos(triangleA.position, rootNode)->triangles;
-		localTriangles = tree.SearchTri(triangleA, rootNode);
-		for (Triangle triangleB : localTriangles) {
-			if (triangleA != triangleB) {
-				edgeVertices.clear();
-				neighbourNormals.clear();
-
-				for (int i = 0; i < 3; i++) {
-					DirectX::XMFLOAT3 A = triangleA.triangleVertices[i];
-					for (int j = 0; j < 3; j++) {
-						if (A == triangleB.triangleVertices[j]) {
-							edgeVertices.push_back(A);
-						}
-					}
-				}
 
-				if (edgeVertices.size() > 1) {
-					//The triangles have a shared edge, calculate the edge weight
-					
-					for (int i = 0; i < 3; i++) {
-						if (triangleA.triangleVertices[i] != edgeVertices[0] || triangleA.triangleVertices[i] != edgeVertices[1])
-							neighbourNormals.push_back(triangleA.triangleNormals[i]);
-						if (triangleB.triangleVertices[i] != edgeVertices[0] || triangleB.triangleVertices[i] != edgeVertices[1])
-							neighbourNormals.push_back(triangleB.triangleNormals[i]);
-					}
-
-					float edgeWeight = 0.0f;
-
-					switch (mode) {
-					case SOD:
-						edgeWeight = CalculateSODWeight(triangleA, triangleB);
-						break;
-					case ESOD:
-						edgeWeight = CalculateESODWeight(neighbourNormals[0], neighbourNormals[1]);
-						break;
-					default:
-						OutputDebugStringA("\nNO MODE SELECTED!\n");
-					}
-					if (edgeWeight > weightThreshold) {
-						vertexPositions.push_back(edgeVertices[0]);
-						vertexPositions.push_back(edgeVertices[1]);
-					}
-				}
-			}
+	auto representative = [&](unsigned int weldedVertex) {
+		return decodedWeld ? tolerantWeld.Representative(weldedVertex) : weld.Representative(weldedVertex);
+	};
+	const ScratchVector<EdgeAdjacency::Edge>& edges = adjacency.GetEdges();
+
+	unsigned int chunkCount = 0;
+	if (neighbourIndex == EDGE_ADJACENCY) {
+		//Records of one edge are adjacent, and no chunk starts inside such a group, so an
+		//edge already drawn for one pair of a non-manifold fan is not drawn for the next.
+		unsigned int recordCount = (unsigned int)edges.size();
+		chunkCount = (recordCount + chunkSize - 1) / chunkSize;
+		chunkStarts.resize(chunkCount + 1);
+		for (unsigned int chunk = 0; chunk < chunkCount; chunk++) {
+			unsigned int first = chunk * chunkSize;
+			while (first > 0 && first < recordCount && SameEdge(edges[first - 1], edges[first]))
+				first++;
+			chunkStarts[chunk] = first;
 		}
+		chunkStarts[chunkCount] = recordCount;
+	} else if (neighbourIndex == HALF_EDGE) {
+		chunkCount = (halfEdges.HalfEdgeCount() + chunkSize - 1) / chunkSize;
+	} else {
+		chunkCount = ((unsigned int)meshTriangles.size() + chunkSize - 1) / chunkSize;
+	}
+	chunks.reserve(chunkCount);
+	for (unsigned int chunk = 0; chunk < chunkCount; chunk++)
+		chunks.emplace_back(arena);
+
+	//The mode is only looked at once per mesh and the index format once per chunk.
+	auto search = [&](const Triangle& triangle, Kdtree::IndexSpan spans[3]) {
+		return neighbourIndex == KDTREE ? tree.SearchTri(triangle, rootNode, spans) : grid.SearchTri(triangle, spans);
+	};
+	auto extract = [&](const auto& edgeOperator) {
+		typedef typename std::decay<decltype(edgeOperator)>::type Operator;
+		parallel_for(0u, chunkCount, [&](unsigned int chunkIndex) {
+			EdgeChunk& chunk = chunks[chunkIndex];
+			chunk.weightBatch.SetClassification(weightClassification);
+			if (neighbourIndex == EDGE_ADJACENCY && view.GetIndexFormat() == MeshView::INDEX_UINT16)
+				ExtractAdjacentChunk<Operator>(chunk, edges, chunkStarts[chunkIndex], chunkStarts[chunkIndex + 1],
+					meshTriangles.data(), weldedIndices.data(), view.GetIndices<unsigned short>(), view, representative, weightThreshold);
+			else if (neighbourIndex == EDGE_ADJACENCY)
+				ExtractAdjacentChunk<Operator>(chunk, edges, chunkStarts[chunkIndex], chunkStarts[chunkIndex + 1],
+					meshTriangles.data(), weldedIndices.data(), view.GetIndices<unsigned int>(), view, representative, weightThreshold);
+			else if (neighbourIndex == HALF_EDGE && view.GetIndexFormat() == MeshView::INDEX_UINT16)
+				ExtractHalfEdgeChunk<Operator>(chunk, halfEdges, chunkIndex * chunkSize, std::min((chunkIndex + 1) * chunkSize, halfEdges.HalfEdgeCount()),
+					meshTriangles.data(), view.GetIndices<unsigned short>(), view, representative, weightThreshold);
+			else if (neighbourIndex == HALF_EDGE)
+				ExtractHalfEdgeChunk<Operator>(chunk, halfEdges, chunkIndex * chunkSize, std::min((chunkIndex + 1) * chunkSize, halfEdges.HalfEdgeCount()),
+					meshTriangles.data(), view.GetIndices<unsigned int>(), view, representative, weightThreshold);
+			else
+				ExtractSpatialChunk<Operator>(chunk, meshTriangles.data(), chunkIndex * chunkSize,
+					std::min((chunkIndex + 1) * chunkSize, (unsigned int)meshTriangles.size()), search, weightThreshold);
+		});
+	};
+
+	switch (mode) {
+	case SOD:
+		extract(SODOperator());
+		break;
+	case ESOD:
+		extract(ESODOperator());
+		break;
+	default:
+		OutputDebugStringA("\nNO MODE SELECTED!\n");
 	}
+
+	size_t lineVertexCount = 0;
+	for (const EdgeChunk& chunk : chunks)
+		lineVertexCount += chunk.lines.size();
+	vertexPositions.reserve(lineVertexCount);
+	for (const EdgeChunk& chunk : chunks)
+		vertexPositions.insert(vertexPositions.end(), chunk.lines.begin(), chunk.lines.end());
 	
 	/*
 	for (auto it1 = indexData.begin(); it1 != indexData.end(); it1 += 3) {
@@ -481,11 +568,30 @@ void HolographicSpatialMapping::HolographicSpatialMappingMain::PopulateEdgeList(
 
 	}
 	*/
-	
+
+#ifdef KDTREE_STATS
+	if (neighbourIndex == KDTREE) {
+		Kdtree::Stats stats = tree.GetStats();
+		double queries = stats.queries > 0 ? (double)stats.queries : 1.0;
+		char statsBuffer[255];
+		sprintf_s(statsBuffer, 255, "Kdtree: %u nodes, %u leaves, %u bytes, built in %f seconds, %.1f nodes and %.1f candidates per query.\n",
+			stats.nodeCount, stats.leafCount, (unsigned int)stats.bytes, stats.buildSeconds, stats.visitedNodes / queries, stats.candidates / queries);
+		OutputDebugStringA(statsBuffer);
+
+		std::string histogram = "Kdtree leaves per depth:";
+		for (unsigned int count : stats.depthHistogram)
+			histogram += " " + std::to_string(count);
+		histogram += "\nKdtree leaves per occupancy:";
+		for (unsigned int count : stats.leafOccupancy)
+			histogram += " " + std::to_string(count);
+		histogram += "\n";
+		OutputDebugStringA(histogram.c_str());
+	}
+#endif
+
 	//At least 2 vertices are required to draw a line
 	if (vertexPositions.size() > 1) {
-		std::vector<DirectX::XMFLOAT3>* vertexPtr = &vertexPositions;
-		edgeRenderer->CreateBuffer(vertexPtr, modelCoord);
+		edgeRenderer->CreateBuffer(vertexPositions.data(), (unsigned int)vertexPositions.size(), modelCoord);
 
 #ifdef MATLAB_DATA
 		matLock.lock();
@@ -550,7 +656,7 @@ void HolographicSpatialMapping::HolographicSpatialMappingMain::PopulateEdgeList(
 				stream3 << std::to_string(v_t.x).c_str() << " " << std::to_string(v_t.y).c_str() << " " << std::to_string(v_t.z).c_str() << "\n";
 			}
 			//ADD INDICES/FACES
-			for (std::vector<UINT>::iterator it = indexData.begin(); it != indexData.end() && it + 1 != indexData.end() && it + 2 != indexData.end(); it += 3) {
+			for (ScratchVector<UINT>::iterator it = indexData.begin(); it != indexData.end() && it + 1 != indexData.end() && it + 2 != indexData.end(); it += 3) {
 				stream3 << "3 " << *it << " " << *(it + 1) << " " << *(it + 2) << "\n";
 			}
 			stream3.seekp(-2, std::ios_base::cur);
@@ -568,6 +674,14 @@ void HolographicSpatialMapping::HolographicSpatialMappingMain::PopulateEdgeList(
 		timer = clock() - timer;
 		sprintf_s(buffer, 255, "Sent to render, took %f seconds.\n", (float)timer / CLOCKS_PER_SEC);
 		OutputDebugStringA(buffer);
+		if (indexAdjacency) {
+			sprintf_s(buffer, 255, "Welded %u of %u vertices.\n", mergedVertices, InputVertexCount);
+			OutputDebugStringA(buffer);
+		}
+		ScratchArena::Counters scratchCounters = arena->GetCounters();
+		sprintf_s(buffer, 255, "Scratch: %u allocations, %u bytes, %u from the heap, %u bytes held.\n",
+			scratchCounters.allocations, (unsigned int)scratchCounters.bytes, scratchCounters.systemAllocations, (unsigned int)scratchCounters.capacity);
+		OutputDebugStringA(buffer);
 	}
 	return;
 }
@@ -608,19 +722,12 @@ float HolographicSpatialMapping::HolographicSpatialMappingMain::CalculateESODWei
 	return DirectX::XMScalarACos(DirectX::XMVectorGetX(DirectX::XMVector3Dot(DirectX::XMVector3Normalize(vertexAnormal), DirectX::XMVector3Normalize(vertexBnormal))));
 }
 
-float HolographicSpatialMapping::HolographicSpatialMappingMain::CalculateSODWeight(Triangle triangleA, Triangle triangleB) {
-	DirectX::XMVECTOR A1 = { triangleA.triangleVertices[0].x,triangleA.triangleVertices[0].y,triangleA.triangleVertices[0].z };
-	DirectX::XMVECTOR A2 = { triangleA.triangleVertices[1].x,triangleA.triangleVertices[1].y,triangleA.triangleVertices[1].z };
-	DirectX::XMVECTOR A3 = { triangleA.triangleVertices[2].x,triangleA.triangleVertices[2].y,triangleA.triangleVertices[2].z };
-
-	DirectX::XMVECTOR B1 = { triangleB.triangleVertices[0].x,triangleB.triangleVertices[0].y,triangleB.triangleVertices[0].z };
-	DirectX::XMVECTOR B2 = { triangleB.triangleVertices[1].x,triangleB.triangleVertices[1].y,triangleB.triangleVertices[1].z };
-	DirectX::XMVECTOR B3 = { triangleB.triangleVertices[2].x,triangleB.triangleVertices[2].y,triangleB.triangleVertices[2].z };
-
-	DirectX::XMVECTOR triangleANormal = normal(A1, A2, A3);
-	DirectX::XMVECTOR triangleBNormal = normal(B1, B2, B3);
+float HolographicSpatialMapping::HolographicSpatialMappingMain::CalculateSODWeight(const Triangle& triangleA, const Triangle& triangleB) {
+	//Face normals are cached unit length by the Triangle constructor
+	DirectX::XMVECTOR triangleANormal = DirectX::XMLoadFloat3(&triangleA.faceNormal);
+	DirectX::XMVECTOR triangleBNormal = DirectX::XMLoadFloat3(&triangleB.faceNormal);
 
-	return DirectX::XMScalarACos(DirectX::XMVectorGetX(DirectX::XMVector3Dot(DirectX::XMVector3Normalize(triangleANormal), DirectX::XMVector3Normalize(triangleBNormal))));
+	return DirectX::XMScalarACos(DirectX::XMVectorGetX(DirectX::XMVector3Dot(triangleANormal, triangleBNormal)));
 }
 //---
 
@@ -707,12 +814,11 @@ HolographicFrame^ HolographicSpatialMappingMain::Update()
 
 			// If you are using a very high detail setting with spatial mapping, it can be beneficial
 			// to use a 32-bit unsigned integer format for indices instead of the default 16-bit. 
-			// Uncomment the following code to enable 32-bit indices.
-			//IVectorView<DirectXPixelFormat>^ supportedTriangleIndexFormats = m_surfaceMeshOptions->SupportedTriangleIndexFormats;
-			//if (supportedTriangleIndexFormats->IndexOf(DirectXPixelFormat::R32UInt, &formatIndex))
-			//{
-			//    m_surfaceMeshOptions->TriangleIndexFormat = DirectXPixelFormat::R32UInt;
-			//}
+			IVectorView<DirectXPixelFormat>^ supportedTriangleIndexFormats = m_surfaceMeshOptions->SupportedTriangleIndexFormats;
+			if (wideIndices && supportedTriangleIndexFormats->IndexOf(DirectXPixelFormat::R32UInt, &formatIndex))
+			{
+				m_surfaceMeshOptions->TriangleIndexFormat = DirectXPixelFormat::R32UInt;
+			}
 
 			// Create the observer.
 			m_surfaceObserver = ref new SpatialSurfaceObserver();
@@ -758,6 +864,12 @@ HolographicFrame^ HolographicSpatialMappingMain::Update()
 	if (needSpatialMapping && m_surfaceObserver) {
 		options = ref new SpatialSurfaceMeshOptions();
 		options->IncludeVertexNormals = true;
+		unsigned int formatIndex = 0;
+		//Packed positions weld exactly on their raw bits and decode four at a time
+		if (options->SupportedVertexPositionFormats->IndexOf(DirectXPixelFormat::R16G16B16A16IntNormalized, &formatIndex))
+			options->VertexPositionFormat = DirectXPixelFormat::R16G16B16A16IntNormalized;
+		if (wideIndices && options->SupportedTriangleIndexFormats->IndexOf(DirectXPixelFormat::R32UInt, &formatIndex))
+			options->TriangleIndexFormat = DirectXPixelFormat::R32UInt;
 
 		auto surfaceMap = m_surfaceObserver->GetObservedSurfaces();
 
@@ -28,6 +28,15 @@
 //---
 #include "EdgeRenderer.h"
 #include "Kdtree.h"
+#include "SpatialGrid.h"
+#include "EdgeAdjacency.h"
+#include "QuantizedWeld.h"
+#include "VertexWeld.h"
+#include "EdgeOperators.h"
+#include "EdgeExtraction.h"
+#include "MeshDecode.h"
+#include "MeshView.h"
+#include "ScratchArena.h"
 #define MATLAB_DATA
 //---
 
@@ -63,6 +72,7 @@ namespace HolographicSpatialMapping
 
 		//---
 		enum EdgeOperator { SOD, ESOD };
+		enum NeighbourIndex { EDGE_ADJACENCY, HALF_EDGE, KDTREE, HASH_GRID };
 
 		//Helper function for populating edge-list needed for edge-weight calculations
 		void HolographicSpatialMapping::HolographicSpatialMappingMain::PopulateEdgeList(
@@ -143,14 +153,32 @@ namespace HolographicSpatialMapping
 		//"ESOD": Extended Second Order Difference
 		EdgeOperator mode = ESOD;
 
+		//Method used to find the neighbours of each triangle:
+		//
+		//"EDGE_ADJACENCY": Shared vertex indices, straight from the index buffer
+		//"HALF_EDGE": Twins of a half-edge mesh over the same indices, which only pairs the
+		//two faces of a manifold, consistently wound edge
+		//"KDTREE": Kdtree over the triangle centroids, matching vertices by position
+		//"HASH_GRID": Hashed uniform grid with cells of one average edge length
+		NeighbourIndex neighbourIndex = EDGE_ADJACENCY;
+
+		//Vertices closer than this many metres are merged before the adjacency is built.
+		//Zero only merges vertices with identical raw positions.
+		float weldEpsilon = 0.0f;
+
 		double meshDensity = 1000.0;
+		//Request 32-bit triangle indices where supported, so a surface is not limited to
+		//65536 vertices at high mesh densities.
+		bool wideIndices = true;
 		float weightThreshold = 0.55f;
+		//COSINE compares edge cosines against cos(weightThreshold) and needs no acos.
+		EdgeWeightBatch::Classification weightClassification = EdgeWeightBatch::COSINE;
 
 		//Weight calculation methods
 		float HolographicSpatialMapping::HolographicSpatialMappingMain::CalculateSODWeight(DirectX::XMFLOAT3 triangleA[3], DirectX::XMFLOAT3 triangleB[3]);
 		float HolographicSpatialMapping::HolographicSpatialMappingMain::CalculateESODWeight(DirectX::XMFLOAT3 vertexANormal, DirectX::XMFLOAT3 vertexBNormal);
 
-		float HolographicSpatialMapping::HolographicSpatialMappingMain::CalculateSODWeight(Triangle triangleA, Triangle triangleB);
+		float HolographicSpatialMapping::HolographicSpatialMappingMain::CalculateSODWeight(const Triangle& triangleA, const Triangle& triangleB);
 
 		//std::map<GUID,std::vector<DirectX::XMFLOAT3>>* vertexMap = nullptr;
 		//std::map<GUID,std::vector<DirectX::XMFLOAT3>>* normalsMap = nullptr;
@@ -168,6 +196,9 @@ namespace HolographicSpatialMapping
 		bool needSpatialMapping = true;
 		bool featuresExtracted = false;
 
+		//One scratch arena per surface being extracted at the same time.
+		ScratchArenaPool scratchArenas;
+
 		//Text output 
 #ifdef MATLAB_DATA
 		std::mutex matLock;
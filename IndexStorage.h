@@ -0,0 +1,159 @@
+#pragma once
+
+#include "ScratchArena.h"
+#include <algorithm>
+
+//Storage shared by the index structures: the open addressing tables of the adjacency and
+//weld passes, and the packed lists of triangle indices behind the Kdtree leaves and the
+//SpatialGrid buckets.
+
+//Golden ratio multiplier of Fibonacci hashing, 2^64 / phi.
+const unsigned long long FIBONACCI_MULTIPLIER = 0x9E3779B97F4A7C15ull;
+
+//Mask of a power of two table with at least minimumSize slots, and never fewer than 16.
+inline unsigned int HashTableMask(unsigned int minimumSize)
+{
+	unsigned int tableSize = 16;
+	while (tableSize < minimumSize) {
+		tableSize *= 2;
+	}
+	return tableSize - 1;
+}
+
+//First slot of a 64-bit key: Fibonacci hashing, keeping the well mixed upper half of the
+//product. Callers probe linearly from there with (slot + 1) & tableMask.
+inline unsigned int HashSlot(unsigned long long key, unsigned int tableMask)
+{
+	return (unsigned int)((key * FIBONACCI_MULTIPLIER) >> 32) & tableMask;
+}
+
+//Many short lists of indices packed back to back in one array, as compressed sparse rows.
+//The owner keeps one range per list, any struct with unsigned int offset, count and
+//capacity, and may add fields of its own. A bulk fill counts every list, lays them out
+//packed with Layout and then Pushes the entries. A list that outgrows its capacity later
+//moves to the end of the array with double the room and leaves its old slots behind as
+//garbage, which Append compacts away once it is half of the array.
+class PackedRanges
+{
+public:
+	explicit PackedRanges(ScratchArena* arena = nullptr) : entries(arena) {}
+
+	void Clear()
+	{
+		entries.clear();
+		garbage = 0;
+	}
+
+	//Gives every range room for its count, back to back in order, and empties it for Push.
+	//Whatever the array held before is dropped.
+	template <class Ranges>
+	void Layout(Ranges& ranges);
+
+	//Adds an entry to a range that Layout made room for.
+	template <class Range>
+	void Push(Range& range, unsigned int entry) { entries[range.offset + range.count++] = entry; }
+
+	//Adds an entry to ranges[index], growing it when it is full. Compacting may move every
+	//range, so the whole set is passed.
+	template <class Ranges>
+	void Append(Ranges& ranges, unsigned int index, unsigned int entry);
+
+	//Removes one occurrence of entry by moving the last entry into its place. Returns
+	//whether it was there.
+	template <class Range>
+	bool Remove(Range& range, unsigned int entry);
+
+	//Empties a range and leaves all of its slots behind as garbage.
+	template <class Range>
+	void Release(Range& range);
+
+	//Packs the ranges back to back in order, each with room for exactly its count.
+	template <class Ranges>
+	void Compact(Ranges& ranges);
+
+	template <class Range>
+	const unsigned int* Begin(const Range& range) const { return entries.data() + range.offset; }
+	template <class Range>
+	const unsigned int* End(const Range& range) const { return entries.data() + range.offset + range.count; }
+
+	size_t Capacity() const { return entries.capacity(); }
+
+private:
+	ScratchVector<unsigned int> entries;
+	unsigned int garbage = 0;
+};
+
+template <class Ranges>
+void PackedRanges::Layout(Ranges& ranges)
+{
+	unsigned int offset = 0;
+	for (typename Ranges::value_type& range : ranges) {
+		range.offset = offset;
+		range.capacity = range.count;
+		offset += range.count;
+		range.count = 0;
+	}
+	entries.assign(offset, 0);
+	garbage = 0;
+}
+
+template <class Ranges>
+void PackedRanges::Append(Ranges& ranges, unsigned int index, unsigned int entry)
+{
+	typename Ranges::value_type& range = ranges[index];
+	if (range.count == range.capacity) {
+		//A full range at the end of the array grows in place; any other moves to the end
+		//with double the room and leaves its old slots behind as garbage.
+		unsigned int capacity = std::max(4u, 2 * range.capacity);
+		unsigned int end = (unsigned int)entries.size();
+		if (range.capacity > 0 && range.offset + range.capacity == end) {
+			entries.resize(range.offset + capacity);
+		} else {
+			entries.resize(end + capacity);
+			std::copy(entries.begin() + range.offset, entries.begin() + range.offset + range.count, entries.begin() + end);
+			garbage += range.capacity;
+			range.offset = end;
+		}
+		range.capacity = capacity;
+	}
+	entries[range.offset + range.count++] = entry;
+
+	if (garbage > entries.size() / 2) {
+		Compact(ranges);
+	}
+}
+
+template <class Range>
+bool PackedRanges::Remove(Range& range, unsigned int entry)
+{
+	unsigned int* first = entries.data() + range.offset;
+	for (unsigned int i = 0; i < range.count; i++) {
+		if (first[i] == entry) {
+			first[i] = first[--range.count];
+			return true;
+		}
+	}
+	return false;
+}
+
+template <class Range>
+void PackedRanges::Release(Range& range)
+{
+	garbage += range.capacity;
+	range.count = range.capacity = 0;
+}
+
+template <class Ranges>
+void PackedRanges::Compact(Ranges& ranges)
+{
+	ScratchVector<unsigned int> packed(entries.get_allocator());
+	packed.reserve(entries.size() - garbage);
+	for (typename Ranges::value_type& range : ranges) {
+		unsigned int offset = (unsigned int)packed.size();
+		packed.insert(packed.end(), entries.begin() + range.offset, entries.begin() + range.offset + range.count);
+		range.offset = offset;
+		range.capacity = range.count;
+	}
+	entries.swap(packed);
+	garbage = 0;
+}
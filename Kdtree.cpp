@@ -1,6 +1,14 @@
 #pragma once
 #include "pch.h"
 #include "Kdtree.h"
+#include <ppl.h>
+#include <limits>
+
+#ifdef KDTREE_STATS
+#define KDTREE_STAT(statement) statement
+#else
+#define KDTREE_STAT(statement)
+#endif
 
 static bool sortX(Triangle A, Triangle B)
 {
@@ -17,116 +25,1195 @@ static bool sortZ(Triangle A, Triangle B)
 	return A.position.z < B.position.z;
 }
 
-Kdtree::Node* Kdtree::Create(std::vector<Triangle> triangles, int depth, int maxdepth) {
+static float AxisValue(const DirectX::XMFLOAT3& v, Kdtree::Axis axis)
+{
+	return (&v.x)[axis];
+}
 
-	Node* node = new Node;
-	unsigned int minTriangles = 2;
-	if (triangles.size() >= minTriangles) {
-		if (depth >= maxdepth) {
-			node->type = LEAF;
-			node->triangles = {};
-			nodes.push_back(node);
-			return node;
+static float LongestEdge(const Triangle& triangle)
+{
+	float longest = 0.0f;
+	for (int i = 0; i < 3; i++) {
+		DirectX::XMVECTOR edge = DirectX::XMVectorSubtract(
+			DirectX::XMLoadFloat3(&triangle.triangleVertices[(i + 1) % 3]),
+			DirectX::XMLoadFloat3(&triangle.triangleVertices[i]));
+		longest = std::max(longest, DirectX::XMVectorGetX(DirectX::XMVector3Length(edge)));
+	}
+	return longest;
+}
+
+//Binned SAH parameters. The cost of a leaf is one unit per triangle it holds.
+static const int SAH_BINS = 16;
+static const float SAH_TRAVERSAL_COST = 1.0f;
+static const unsigned int SAH_MAX_LEAF_TRIANGLES = 4;
+
+const float Kdtree::REBALANCE_ALPHA = 0.7f;
+const float Kdtree::REBUILD_FRACTION = 0.4f;
+
+bool Kdtree::InsideCell(const Cell& cell, const DirectX::XMFLOAT3& v)
+{
+	const float coords[3] = { v.x, v.y, v.z };
+	for (int a = 0; a < 3; a++) {
+		if (!(cell.lo[a] <= coords[a] && coords[a] < cell.hi[a]))
+			return false;
+	}
+	return true;
+}
+
+Kdtree::NodeIndex Kdtree::Create(const ScratchVector<Triangle>& triangles, int depth, int maxdepth, BuildMode buildMode) {
+	KDTREE_STAT(clock_t timer = clock());
+	nodes.clear();
+	leaves.clear();
+	leafTriangles.Clear();
+	triangleSource = &triangles;
+	maxEdgeLength = 0.0f;
+	garbageNodes = 0;
+	liveTriangles = 0;
+	maxdepth = std::min(maxdepth, MAX_DEPTH);
+	maxDepth = maxdepth;
+
+	if (buildMode == SORT_COPY) {
+		nodes.reserve(2 * triangles.size() + 2);
+		nodes.resize(2);
+		builtTriangles = (unsigned int)triangles.size();
+		ScratchVector<Triangle> sorted(triangles.begin(), triangles.end(), nodes.get_allocator());
+		Build(sorted, ROOT, depth, maxdepth);
+	} else {
+		ScratchVector<unsigned int> order(triangles.size(), 0, nodes.get_allocator());
+		for (unsigned int i = 0; i < triangles.size(); i++) {
+			order[i] = i;
+		}
+		BuildNodes(order.data(), order.data() + order.size(), depth);
+	}
+
+	NumberLeaves();
+	counts.assign(nodes.size(), 0);
+	KDTREE_STAT(buildSeconds = (double)(clock() - timer) / CLOCKS_PER_SEC);
+	KDTREE_STAT(queryStats.Reset());
+	return ROOT;
+}
+
+void Kdtree::BuildNodes(unsigned int* first, unsigned int* last, int depth)
+{
+	//A median split tree has at most 2n - 1 nodes. Slot 1 is padding so that every
+	//sibling pair after the root starts on an even index.
+	const ScratchVector<Triangle>& triangles = *triangleSource;
+	nodes.clear();
+	nodes.reserve(2 * (last - first) + 2);
+	nodes.resize(2);
+	builtTriangles = (unsigned int)(last - first);
+
+	BuildData data(splitStrategy, nodes.get_allocator());
+	data.centroids.resize(triangles.size());
+	for (const unsigned int* t = first; t != last; t++) {
+		data.centroids[*t] = triangles[*t].position;
+	}
+	if (splitStrategy == SAH) {
+		data.bounds.resize(triangles.size());
+		for (const unsigned int* t = first; t != last; t++) {
+			Bounds& b = data.bounds[*t];
+			b.min = b.max = triangles[*t].triangleVertices[0];
+			for (const DirectX::XMFLOAT3& v : triangles[*t].triangleVertices) {
+				b.min = DirectX::XMFLOAT3(std::min(b.min.x, v.x), std::min(b.min.y, v.y), std::min(b.min.z, v.z));
+				b.max = DirectX::XMFLOAT3(std::max(b.max.x, v.x), std::max(b.max.y, v.y), std::max(b.max.z, v.z));
+			}
+		}
+	}
+	BuildInPlace(data, first, last, nodes, ROOT, depth, maxDepth);
+}
+
+void Kdtree::SetParallelBuild(int parallelDepth, unsigned int sequentialCutoff) {
+	this->parallelDepth = parallelDepth;
+	this->sequentialCutoff = sequentialCutoff;
+}
+
+Kdtree::NodeIndex Kdtree::Split(NodeVector& out, NodeIndex node, Axis axis, float split) {
+	NodeIndex children = (NodeIndex)out.size();
+	out.resize(out.size() + 2);
+	out[node].split = split;
+	out[node].tag = (children << INDEX_SHIFT) | axis;
+	return children;
+}
+
+void Kdtree::MakeLeaf(NodeVector& out, NodeIndex node) {
+	out[node].split = 0.0f;
+	out[node].tag = LEAF;
+}
+
+void Kdtree::Graft(NodeVector& out, NodeIndex slot, const NodeVector& subtree) {
+	//The subtree was built with its root at index 0 and its descendants from index 1,
+	//so its root goes into the reserved slot and the rest is appended, shifting every
+	//child reference by the same amount.
+	NodeIndex offset = (NodeIndex)out.size() - 1;
+	for (unsigned int i = 0; i < subtree.size(); i++) {
+		Node node = subtree[i];
+		if (!node.IsLeaf()) {
+			node.tag += offset << INDEX_SHIFT;
+		}
+		if (i == 0) {
+			out[slot] = node;
 		} else {
-			node->type = SPLIT;
-			Axis splitAxis = Axis(depth % 3);
-			node->split.first = splitAxis;
-			int medianIndex = (int)(triangles.size() / 2);
-			switch (splitAxis)
-			{
-			case X:
-				std::sort(triangles.begin(), triangles.end(), sortX);
-				node->split.second = triangles[medianIndex].position.x;
-				break;
-			case Y:
-				std::sort(triangles.begin(), triangles.end(), sortY);
-				node->split.second = triangles[medianIndex].position.y;
-				break;
-			case Z:
-				std::sort(triangles.begin(), triangles.end(), sortZ);
-				node->split.second = triangles[medianIndex].position.z;
-				break;
-			default:
-				break;
+			out.push_back(node);
+		}
+	}
+}
+
+void Kdtree::NumberLeaves() {
+	unsigned int leafCount = 0;
+	for (NodeIndex i = 0; i < nodes.size(); i++) {
+		if (nodes[i].IsLeaf()) {
+			nodes[i].tag = (leafCount++ << INDEX_SHIFT) | LEAF;
+		}
+	}
+	leaves.resize(leafCount);
+}
+
+void Kdtree::Build(ScratchVector<Triangle>& triangles, NodeIndex node, int depth, int maxdepth) {
+	unsigned int minTriangles = 2;
+	if (triangles.size() < minTriangles || depth >= maxdepth) {
+		MakeLeaf(nodes, node);
+		return;
+	}
+
+	Axis splitAxis = Axis(depth % 3);
+	int medianIndex = (int)(triangles.size() / 2);
+	float split = 0.0f;
+	switch (splitAxis)
+	{
+	case X:
+		std::sort(triangles.begin(), triangles.end(), sortX);
+		split = triangles[medianIndex].position.x;
+		break;
+	case Y:
+		std::sort(triangles.begin(), triangles.end(), sortY);
+		split = triangles[medianIndex].position.y;
+		break;
+	case Z:
+		std::sort(triangles.begin(), triangles.end(), sortZ);
+		split = triangles[medianIndex].position.z;
+		break;
+	default:
+		break;
+	}
+
+	NodeIndex children = Split(nodes, node, splitAxis, split);
+
+	ScratchVector<Triangle> lessTriangles(triangles.begin(), triangles.begin() + medianIndex, triangles.get_allocator());
+	ScratchVector<Triangle> moreTriangles(triangles.begin() + medianIndex, triangles.end(), triangles.get_allocator());
+	Build(lessTriangles, children, depth + 1, maxdepth);
+	Build(moreTriangles, children + 1, depth + 1, maxdepth);
+}
+
+void Kdtree::BuildInPlace(const BuildData& data, unsigned int* first, unsigned int* last, NodeVector& out, NodeIndex node, int depth, int maxdepth) const {
+	unsigned int minTriangles = 2;
+	unsigned int count = (unsigned int)(last - first);
+	if (count < minTriangles || depth >= maxdepth) {
+		MakeLeaf(out, node);
+		return;
+	}
+
+	Axis splitAxis = X;
+	float split = 0.0f;
+	unsigned int* median = nullptr;
+	bool makeLeaf = false;
+	if (data.strategy == EXTENT) {
+		median = PartitionExtent(data, first, last, splitAxis, split);
+		if (median == nullptr) {
+			MakeLeaf(out, node);
+			return;
+		}
+	} else if (data.strategy == SAH && FindSAHSplit(data, first, last, splitAxis, split, makeLeaf)) {
+		if (makeLeaf) {
+			MakeLeaf(out, node);
+			return;
+		}
+		median = std::partition(first, last, [&data, splitAxis, split](unsigned int i) {
+			return AxisValue(data.centroids[i], splitAxis) < split;
+		});
+	}
+	//Fall back to the median when SAH is off or could not separate the centroids.
+	if (median == nullptr || median == first || median == last) {
+		median = PartitionMedian(data, first, last, depth, splitAxis, split);
+	}
+
+	NodeIndex children = Split(out, node, splitAxis, split);
+
+	if (depth >= parallelDepth || count < sequentialCutoff) {
+		BuildInPlace(data, first, median, out, children, depth + 1, maxdepth);
+		BuildInPlace(data, median, last, out, children + 1, depth + 1, maxdepth);
+		return;
+	}
+
+	//The halves cover disjoint parts of the index array, so they can be built
+	//concurrently into private arrays and grafted back in serial order.
+	NodeVector less(1, Node(), out.get_allocator());
+	NodeVector more(1, Node(), out.get_allocator());
+	less.reserve(2 * (median - first));
+	more.reserve(2 * (last - median));
+	concurrency::parallel_invoke(
+		[&] { BuildInPlace(data, first, median, less, 0, depth + 1, maxdepth); },
+		[&] { BuildInPlace(data, median, last, more, 0, depth + 1, maxdepth); }
+	);
+	Graft(out, children, less);
+	Graft(out, children + 1, more);
+}
+
+unsigned int* Kdtree::PartitionMedian(const BuildData& data, unsigned int* first, unsigned int* last, int depth, Axis& axis, float& split) const {
+	//Selecting the median leaves the lower half in [first, median) and the upper half in
+	//[median, last), which is exactly the split the sorting builder produces.
+	Axis splitAxis = Axis(depth % 3);
+	unsigned int* median = first + (last - first) / 2;
+	std::nth_element(first, median, last, [&data, splitAxis](unsigned int a, unsigned int b) {
+		return AxisValue(data.centroids[a], splitAxis) < AxisValue(data.centroids[b], splitAxis);
+	});
+	axis = splitAxis;
+	split = AxisValue(data.centroids[*median], splitAxis);
+	return median;
+}
+
+unsigned int* Kdtree::PartitionExtent(const BuildData& data, unsigned int* first, unsigned int* last, Axis& axis, float& split) const {
+	DirectX::XMFLOAT3 lo = data.centroids[*first];
+	DirectX::XMFLOAT3 hi = lo;
+	for (const unsigned int* it = first; it != last; it++) {
+		const DirectX::XMFLOAT3& c = data.centroids[*it];
+		lo = DirectX::XMFLOAT3(std::min(lo.x, c.x), std::min(lo.y, c.y), std::min(lo.z, c.z));
+		hi = DirectX::XMFLOAT3(std::max(hi.x, c.x), std::max(hi.y, c.y), std::max(hi.z, c.z));
+	}
+	Axis splitAxis = X;
+	for (int a = Y; a <= Z; a++) {
+		if (AxisValue(hi, Axis(a)) - AxisValue(lo, Axis(a)) > AxisValue(hi, splitAxis) - AxisValue(lo, splitAxis)) {
+			splitAxis = Axis(a);
+		}
+	}
+	float low = AxisValue(lo, splitAxis);
+	if (!(AxisValue(hi, splitAxis) > low)) {
+		return nullptr;
+	}
+
+	//Centroids equal to the split go to the upper side, as traversal sends them. When the
+	//median is the lowest value the split moves to the next value above it, so both
+	//sides are always non-empty.
+	unsigned int* median = first + (last - first) / 2;
+	std::nth_element(first, median, last, [&data, splitAxis](unsigned int a, unsigned int b) {
+		return AxisValue(data.centroids[a], splitAxis) < AxisValue(data.centroids[b], splitAxis);
+	});
+	split = AxisValue(data.centroids[*median], splitAxis);
+	if (split == low) {
+		split = AxisValue(hi, splitAxis);
+		for (const unsigned int* it = median; it != last; it++) {
+			float value = AxisValue(data.centroids[*it], splitAxis);
+			if (value > low) {
+				split = std::min(split, value);
 			}
+		}
+	}
+	axis = splitAxis;
+	return std::partition(first, last, [&data, splitAxis, split](unsigned int i) {
+		return AxisValue(data.centroids[i], splitAxis) < split;
+	});
+}
 
-			std::vector<Triangle> lessTriangles = std::vector<Triangle>(triangles.begin(), triangles.begin() + medianIndex);
-			std::vector<Triangle> moreTriangles = std::vector<Triangle>(triangles.begin() + medianIndex, triangles.end());
-			node->leftChild = Create(lessTriangles, depth + 1, maxdepth);
-			node->rightChild = Create(moreTriangles, depth + 1, maxdepth);
-			nodes.push_back(node);
-			return node;
+static float HalfArea(const DirectX::XMFLOAT3& min, const DirectX::XMFLOAT3& max)
+{
+	float dx = max.x - min.x;
+	float dy = max.y - min.y;
+	float dz = max.z - min.z;
+	return dx * dy + dy * dz + dz * dx;
+}
+
+static void Grow(DirectX::XMFLOAT3& min, DirectX::XMFLOAT3& max, const DirectX::XMFLOAT3& lo, const DirectX::XMFLOAT3& hi)
+{
+	min = DirectX::XMFLOAT3(std::min(min.x, lo.x), std::min(min.y, lo.y), std::min(min.z, lo.z));
+	max = DirectX::XMFLOAT3(std::max(max.x, hi.x), std::max(max.y, hi.y), std::max(max.z, hi.z));
+}
+
+bool Kdtree::FindSAHSplit(const BuildData& data, const unsigned int* first, const unsigned int* last, Axis& axis, float& split, bool& makeLeaf) const {
+	struct Bin
+	{
+		DirectX::XMFLOAT3 min;
+		DirectX::XMFLOAT3 max;
+		unsigned int count;
+	};
+	const float inf = std::numeric_limits<float>::infinity();
+	const DirectX::XMFLOAT3 emptyMin(inf, inf, inf);
+	const DirectX::XMFLOAT3 emptyMax(-inf, -inf, -inf);
+
+	DirectX::XMFLOAT3 centroidMin = emptyMin, centroidMax = emptyMax;
+	DirectX::XMFLOAT3 boundsMin = emptyMin, boundsMax = emptyMax;
+	for (const unsigned int* it = first; it != last; it++) {
+		Grow(centroidMin, centroidMax, data.centroids[*it], data.centroids[*it]);
+		Grow(boundsMin, boundsMax, data.bounds[*it].min, data.bounds[*it].max);
+	}
+	unsigned int count = (unsigned int)(last - first);
+	float parentArea = HalfArea(boundsMin, boundsMax);
+	if (!(parentArea > 0.0f)) {
+		parentArea = 1.0f;
+	}
+
+	float bestCost = inf;
+	for (int a = X; a <= Z; a++) {
+		Axis binAxis = Axis(a);
+		float lo = AxisValue(centroidMin, binAxis);
+		float extent = AxisValue(centroidMax, binAxis) - lo;
+		if (!(extent > 0.0f)) {
+			continue;
 		}
-	} else {
-		node->type = LEAF;
-		node->triangles = {};
-		nodes.push_back(node);
-		return node;
+
+		Bin bins[SAH_BINS];
+		for (Bin& bin : bins) {
+			bin.min = emptyMin;
+			bin.max = emptyMax;
+			bin.count = 0;
+		}
+		float scale = SAH_BINS / extent;
+		for (const unsigned int* it = first; it != last; it++) {
+			int b = std::min((int)((AxisValue(data.centroids[*it], binAxis) - lo) * scale), SAH_BINS - 1);
+			bins[b].count++;
+			Grow(bins[b].min, bins[b].max, data.bounds[*it].min, data.bounds[*it].max);
+		}
+
+		//Sweep from the right to get the cost of everything above each candidate plane,
+		//then from the left to evaluate the planes between bins.
+		float rightArea[SAH_BINS];
+		unsigned int rightCount[SAH_BINS];
+		DirectX::XMFLOAT3 sweepMin = emptyMin, sweepMax = emptyMax;
+		unsigned int sweepCount = 0;
+		for (int b = SAH_BINS - 1; b > 0; b--) {
+			Grow(sweepMin, sweepMax, bins[b].min, bins[b].max);
+			sweepCount += bins[b].count;
+			rightArea[b] = sweepCount > 0 ? HalfArea(sweepMin, sweepMax) : 0.0f;
+			rightCount[b] = sweepCount;
+		}
+		sweepMin = emptyMin;
+		sweepMax = emptyMax;
+		sweepCount = 0;
+		for (int b = 0; b < SAH_BINS - 1; b++) {
+			Grow(sweepMin, sweepMax, bins[b].min, bins[b].max);
+			sweepCount += bins[b].count;
+			if (sweepCount == 0 || rightCount[b + 1] == 0) {
+				continue;
+			}
+			float cost = SAH_TRAVERSAL_COST +
+				(HalfArea(sweepMin, sweepMax) * sweepCount + rightArea[b + 1] * rightCount[b + 1]) / parentArea;
+			if (cost < bestCost) {
+				bestCost = cost;
+				axis = binAxis;
+				split = lo + (b + 1) / scale;
+			}
+		}
+	}
+
+	if (bestCost == inf) {
+		return false;
 	}
+	makeLeaf = count <= SAH_MAX_LEAF_TRIANGLES && bestCost >= (float)count;
+	return true;
 }
 
-Kdtree::Node* Kdtree::SearchPos(DirectX::XMFLOAT3 pos, Node* rootNode)
+Kdtree::NodeIndex Kdtree::SearchPos(DirectX::XMFLOAT3 pos, NodeIndex rootNode) const
 {
-	Node* node = rootNode;
-	int currentDepth = 0;
-	Axis currentAxis = X;
-	float vertexPos;
+	const float coords[3] = { pos.x, pos.y, pos.z };
+	NodeIndex node = rootNode;
+	Node current = nodes[node];
 
-	while (node->type != LEAF) {
-		switch (currentAxis) {
-		case X:
-			vertexPos = pos.x;
-			break;
-		case Y:
-			vertexPos = pos.y;
-			break;
-		case Z:
-			vertexPos = pos.z;
-			break;
-		default:
+	while (!current.IsLeaf()) {
+		node = coords[current.SplitAxis()] < current.split ? current.LeftChild() : current.RightChild();
+		current = nodes[node];
+	}
+	return node;
+}
+
+void Kdtree::SearchPos(const DirectX::XMFLOAT3* points, unsigned int count, NodeIndex rootNode, NodeIndex* leafNodes) const
+{
+	unsigned int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		SearchPos4(points + i, rootNode, leafNodes + i);
+	}
+	for (; i < count; i++) {
+		leafNodes[i] = SearchPos(points[i], rootNode);
+	}
+}
+
+void Kdtree::SearchPos4(const DirectX::XMFLOAT3* points, NodeIndex rootNode, NodeIndex* leafNodes) const
+{
+	using namespace DirectX;
+
+	//Transpose the four points so that each register holds one coordinate of all lanes.
+	XMMATRIX lanes = XMMatrixTranspose(XMMATRIX(
+		XMLoadFloat3(&points[0]), XMLoadFloat3(&points[1]), XMLoadFloat3(&points[2]), XMLoadFloat3(&points[3])));
+	const XMVECTOR axisMask = XMVectorReplicateInt(AXIS_MASK);
+	const XMVECTOR xAxis = XMVectorReplicateInt(X);
+	const XMVECTOR yAxis = XMVectorReplicateInt(Y);
+
+	NodeIndex lane[4] = { rootNode, rootNode, rootNode, rootNode };
+	for (;;) {
+		//The four node reads are independent, so their cache misses overlap.
+		const Node n[4] = { nodes[lane[0]], nodes[lane[1]], nodes[lane[2]], nodes[lane[3]] };
+		if ((n[0].tag & n[1].tag & n[2].tag & n[3].tag & AXIS_MASK) == LEAF) {
 			break;
 		}
-		if (vertexPos < node->split.second) {
-			node = node->leftChild;
+
+		XMVECTOR split = XMVectorSet(n[0].split, n[1].split, n[2].split, n[3].split);
+		XMVECTOR axis = XMVectorAndInt(XMVectorSetInt(n[0].tag, n[1].tag, n[2].tag, n[3].tag), axisMask);
+		XMVECTOR coord = XMVectorSelect(
+			XMVectorSelect(lanes.r[2], lanes.r[1], XMVectorEqualInt(axis, yAxis)),
+			lanes.r[0], XMVectorEqualInt(axis, xAxis));
+		XMUINT4 less;
+		XMStoreUInt4(&less, XMVectorLess(coord, split));
+
+		//Same rule as SearchPos: left child when coord < split, otherwise the right child
+		//stored next to it. Lanes that already reached a leaf stay put.
+		const unsigned int goRight[4] = { ~less.x & 1, ~less.y & 1, ~less.z & 1, ~less.w & 1 };
+		for (int i = 0; i < 4; i++) {
+			if (!n[i].IsLeaf()) {
+				lane[i] = n[i].LeftChild() + goRight[i];
+			}
+		}
+	}
+
+	for (int i = 0; i < 4; i++) {
+		leafNodes[i] = lane[i];
+	}
+}
+
+unsigned int Kdtree::FindLeaves(const Triangle& triangle, NodeIndex rootNode, NodeIndex found[3], unsigned int& visitedNodes) const
+{
+	unsigned int foundCount = 0;
+	for (const DirectX::XMFLOAT3& vertex : triangle.triangleVertices) {
+		const float coords[3] = { vertex.x, vertex.y, vertex.z };
+		NodeIndex node = rootNode;
+		visitedNodes++;
+		while (!nodes[node].IsLeaf()) {
+			node = coords[nodes[node].SplitAxis()] < nodes[node].split ? nodes[node].LeftChild() : nodes[node].RightChild();
+			visitedNodes++;
+		}
+		if (std::find(found, found + foundCount, node) == found + foundCount) {
+			found[foundCount++] = node;
+		}
+	}
+	return foundCount;
+}
+
+unsigned int Kdtree::SearchTri(const Triangle& triangle, NodeIndex rootNode, IndexSpan spans[3]) const
+{
+	//Without KDTREE_STATS nothing reads visitedNodes and the count compiles away.
+	NodeIndex found[3];
+	unsigned int visitedNodes = 0;
+	unsigned int foundCount = FindLeaves(triangle, rootNode, found, visitedNodes);
+
+	KDTREE_STAT(unsigned int candidates = 0);
+	for (unsigned int i = 0; i < foundCount; i++) {
+		spans[i] = GetLeafTriangles(found[i]);
+		KDTREE_STAT(candidates += spans[i].size());
+	}
+	KDTREE_STAT(queryStats.Add(visitedNodes, candidates));
+	return foundCount;
+}
+
+Kdtree::IndexSpan Kdtree::GetLeafTriangles(NodeIndex leafNode) const
+{
+	const LeafRange& range = leaves[nodes[leafNode].LeafIndex()];
+	IndexSpan span = { leafTriangles.Begin(range), leafTriangles.End(range) };
+	return span;
+}
+
+void Kdtree::Insert(unsigned int triangle, NodeIndex rootNode)
+{
+	const Triangle& source = (*triangleSource)[triangle];
+	maxEdgeLength = std::max(maxEdgeLength, LongestEdge(source));
+	liveTriangles++;
+	bool unbalanced[3];
+	for (int i = 0; i < 3; i++) {
+		unbalanced[i] = AddEntry(source.triangleVertices[i], triangle, rootNode);
+	}
+	for (int i = 0; i < 3; i++) {
+		if (unbalanced[i]) {
+			Rebalance(source.triangleVertices[i], rootNode);
+		}
+	}
+}
+
+void Kdtree::Insert(const std::vector<unsigned int>& triangles, NodeIndex rootNode)
+{
+	InsertRange(triangles.data(), triangles.data() + triangles.size(), rootNode);
+}
+
+void Kdtree::InsertAll(NodeIndex rootNode)
+{
+	ScratchVector<unsigned int> all(triangleSource->size(), 0, nodes.get_allocator());
+	for (unsigned int i = 0; i < all.size(); i++) {
+		all[i] = i;
+	}
+	InsertRange(all.data(), all.data() + all.size(), rootNode);
+}
+
+void Kdtree::InsertRange(const unsigned int* first, const unsigned int* last, NodeIndex rootNode)
+{
+	for (const unsigned int* t = first; t != last; t++) {
+		maxEdgeLength = std::max(maxEdgeLength, LongestEdge((*triangleSource)[*t]));
+	}
+
+	if (counts[rootNode] == 0) {
+		FillLeaves(first, last, rootNode);
+		return;
+	}
+	if (last - first > RebuildThreshold()) {
+		RebuildAll(first, last, true);
+		return;
+	}
+	liveTriangles += (unsigned int)(last - first);
+
+	//Filling a populated tree: update each path, then rebalance the few paths that need it
+	//once at the end.
+	ScratchVector<DirectX::XMFLOAT3> unbalanced(nodes.get_allocator());
+	for (const unsigned int* t = first; t != last; t++) {
+		for (const DirectX::XMFLOAT3& vertex : (*triangleSource)[*t].triangleVertices) {
+			if (AddEntry(vertex, *t, rootNode)) {
+				unbalanced.push_back(vertex);
+			}
+		}
+	}
+	for (const DirectX::XMFLOAT3& vertex : unbalanced) {
+		Rebalance(vertex, rootNode);
+	}
+}
+
+void Kdtree::FillLeaves(const unsigned int* first, const unsigned int* last, NodeIndex rootNode)
+{
+	//Locate all vertices with the batched query. A triangle goes into each distinct leaf
+	//holding one of its vertices once, so the second and third vertex are skipped when
+	//they land in a leaf already used by this triangle.
+	unsigned int triangleCount = (unsigned int)(last - first);
+	ScratchVector<DirectX::XMFLOAT3> vertices(nodes.get_allocator());
+	vertices.reserve(3 * triangleCount);
+	for (const unsigned int* t = first; t != last; t++) {
+		const DirectX::XMFLOAT3* v = (*triangleSource)[*t].triangleVertices;
+		vertices.insert(vertices.end(), v, v + 3);
+	}
+	const NodeIndex skip = ~0u;
+	ScratchVector<NodeIndex> leafNodes(vertices.size(), 0, nodes.get_allocator());
+	SearchPos(vertices.data(), (unsigned int)vertices.size(), rootNode, leafNodes.data());
+	for (unsigned int t = 0; t < triangleCount; t++) {
+		NodeIndex* leafNode = &leafNodes[3 * t];
+		if (leafNode[1] == leafNode[0]) {
+			leafNode[1] = skip;
+		}
+		if (leafNode[2] == leafNode[0] || leafNode[2] == leafNode[1]) {
+			leafNode[2] = skip;
+		}
+	}
+
+	//First pass counts the entries of every leaf, the second writes them into one array.
+	//The tree is empty, so whatever the old array held is garbage.
+	for (NodeIndex leafNode : leafNodes) {
+		if (leafNode != skip) {
+			leaves[nodes[leafNode].LeafIndex()].count++;
+			counts[leafNode]++;
+		}
+	}
+	leafTriangles.Layout(leaves);
+	liveTriangles = triangleCount;
+	for (unsigned int i = 0; i < leafNodes.size(); i++) {
+		if (leafNodes[i] != skip) {
+			leafTriangles.Push(leaves[nodes[leafNodes[i]].LeafIndex()], first[i / 3]);
+		}
+	}
+	for (LeafRange& range : leaves) {
+		range.filled = range.count;
+	}
+
+	//Children always sit after their parent in the pool.
+	for (NodeIndex i = (NodeIndex)nodes.size(); i-- > rootNode;) {
+		if (i != 1 && !nodes[i].IsLeaf()) {
+			counts[i] = counts[nodes[i].LeftChild()] + counts[nodes[i].RightChild()];
+		}
+	}
+}
+
+bool Kdtree::Remove(unsigned int triangle, NodeIndex rootNode)
+{
+	//The first vertex always placed an entry, so it tells whether the triangle is here.
+	const Triangle& source = (*triangleSource)[triangle];
+	int depths[3];
+	depths[0] = RemoveEntry(source.triangleVertices[0], triangle, rootNode);
+	if (depths[0] < 0) {
+		return false;
+	}
+	liveTriangles--;
+	depths[1] = RemoveEntry(source.triangleVertices[1], triangle, rootNode);
+	depths[2] = RemoveEntry(source.triangleVertices[2], triangle, rootNode);
+	for (int i = 0; i < 3; i++) {
+		if (depths[i] > DepthLimit(rootNode)) {
+			Rebalance(source.triangleVertices[i], rootNode);
+		}
+	}
+	return true;
+}
+
+void Kdtree::Remove(const std::vector<unsigned int>& triangles, NodeIndex rootNode)
+{
+	if (triangles.size() > RebuildThreshold()) {
+		RebuildAll(triangles.data(), triangles.data() + triangles.size(), false);
+		return;
+	}
+
+	//Removals only shrink leaves, but they lower the depth limit, so the paths are checked
+	//against the limit left by the whole batch.
+	ScratchVector<DirectX::XMFLOAT3> vertices(nodes.get_allocator());
+	ScratchVector<int> depths(nodes.get_allocator());
+	for (unsigned int triangle : triangles) {
+		const Triangle& source = (*triangleSource)[triangle];
+		int depth = RemoveEntry(source.triangleVertices[0], triangle, rootNode);
+		if (depth < 0) {
+			continue;
+		}
+		liveTriangles--;
+		vertices.insert(vertices.end(), source.triangleVertices, source.triangleVertices + 3);
+		depths.push_back(depth);
+		depths.push_back(RemoveEntry(source.triangleVertices[1], triangle, rootNode));
+		depths.push_back(RemoveEntry(source.triangleVertices[2], triangle, rootNode));
+	}
+	float depthLimit = DepthLimit(rootNode);
+	for (unsigned int i = 0; i < vertices.size(); i++) {
+		if (depths[i] > depthLimit) {
+			Rebalance(vertices[i], rootNode);
+		}
+	}
+}
+
+bool Kdtree::AddEntry(const DirectX::XMFLOAT3& vertex, unsigned int triangle, NodeIndex rootNode)
+{
+	const float coords[3] = { vertex.x, vertex.y, vertex.z };
+	NodeIndex path[MAX_DEPTH + 1];
+	int length = 0;
+	NodeIndex node = rootNode;
+	path[length++] = node;
+	while (!nodes[node].IsLeaf()) {
+		const Node& current = nodes[node];
+		node = coords[current.SplitAxis()] < current.split ? current.LeftChild() : current.RightChild();
+		path[length++] = node;
+	}
+
+	//Another vertex of the triangle may already have placed it in this leaf. The vertices
+	//of a triangle are added one after the other, so it can only be one of the last two.
+	unsigned int leaf = nodes[node].LeafIndex();
+	IndexSpan entries = GetLeafTriangles(node);
+	const unsigned int* recent = entries.size() > 2 ? entries.end() - 2 : entries.begin();
+	if (std::find(recent, entries.end(), triangle) != entries.end()) {
+		return false;
+	}
+	leafTriangles.Append(leaves, leaf, triangle);
+	for (int j = 0; j < length; j++) {
+		counts[path[j]]++;
+	}
+	return length - 1 > DepthLimit(rootNode) || counts[node] > SplitCount(leaf);
+}
+
+int Kdtree::RemoveEntry(const DirectX::XMFLOAT3& vertex, unsigned int triangle, NodeIndex rootNode)
+{
+	const float coords[3] = { vertex.x, vertex.y, vertex.z };
+	NodeIndex path[MAX_DEPTH + 1];
+	int length = 0;
+	NodeIndex node = rootNode;
+	path[length++] = node;
+	while (!nodes[node].IsLeaf()) {
+		const Node& current = nodes[node];
+		node = coords[current.SplitAxis()] < current.split ? current.LeftChild() : current.RightChild();
+		path[length++] = node;
+	}
+
+	if (!leafTriangles.Remove(leaves[nodes[node].LeafIndex()], triangle)) {
+		return -1;
+	}
+	for (int j = 0; j < length; j++) {
+		counts[path[j]]--;
+	}
+	return length - 1;
+}
+
+void Kdtree::RebuildAll(const unsigned int* first, const unsigned int* last, bool insert)
+{
+	//The triangles in the tree are the ones stored in some leaf, with the batch added or
+	//taken away. Build and fill then run over them exactly as Create and InsertAll would.
+	ScratchVector<unsigned char> live(triangleSource->size(), 0, nodes.get_allocator());
+	for (const LeafRange& range : leaves) {
+		for (const unsigned int* t = leafTriangles.Begin(range); t != leafTriangles.End(range); t++) {
+			live[*t] = 1;
+		}
+	}
+	for (const unsigned int* t = first; t != last; t++) {
+		live[*t] = insert ? 1 : 0;
+	}
+	ScratchVector<unsigned int> order(nodes.get_allocator());
+	for (unsigned int t = 0; t < live.size(); t++) {
+		if (live[t]) {
+			order.push_back(t);
+		}
+	}
+
+	//Removing everything keeps the nodes, so that filling the tree again gets the same
+	//shape as before instead of a single leaf.
+	if (order.empty()) {
+		std::fill(leaves.begin(), leaves.end(), LeafRange());
+		std::fill(counts.begin(), counts.end(), 0);
+		leafTriangles.Clear();
+		liveTriangles = 0;
+		return;
+	}
+	leaves.clear();
+	garbageNodes = 0;
+	BuildNodes(order.data(), order.data() + order.size(), 0);
+	NumberLeaves();
+	counts.assign(nodes.size(), 0);
+	FillLeaves(order.data(), order.data() + order.size(), ROOT);
+}
+
+float Kdtree::RebuildThreshold() const
+{
+	//Triangles going back into a region the nodes were built for only cost their paths,
+	//while a batch large next to that set needs many subtree rebuilds. In
+	//KdtreeUpdateBenchmark those cost as much as a full rebuild at 40 to 50% of the tree.
+	return REBUILD_FRACTION * std::max(liveTriangles, builtTriangles);
+}
+
+float Kdtree::DepthLimit(NodeIndex rootNode) const
+{
+	//As in a scapegoat tree, a path may grow to log base 1/alpha of the entry count.
+	return logf((float)std::max(counts[rootNode], 2u)) / -logf(REBALANCE_ALPHA);
+}
+
+unsigned int Kdtree::SplitCount(unsigned int leaf) const
+{
+	//Leaves are split once they have doubled from their filled size and hold more than
+	//LEAF_MAX_ENTRIES. Leaves the builder left large, such as those of a median tree on a
+	//flat surface, keep their size.
+	return std::max(LEAF_MAX_ENTRIES, 2 * leaves[leaf].filled);
+}
+
+void Kdtree::Rebalance(const DirectX::XMFLOAT3& vertex, NodeIndex rootNode)
+{
+	const float coords[3] = { vertex.x, vertex.y, vertex.z };
+	const float inf = std::numeric_limits<float>::infinity();
+	NodeIndex path[MAX_DEPTH + 1];
+	Cell cells[MAX_DEPTH + 1];
+	int depth = 0;
+	path[0] = rootNode;
+	cells[0] = { { -inf, -inf, -inf }, { inf, inf, inf } };
+
+	while (!nodes[path[depth]].IsLeaf()) {
+		const Node& current = nodes[path[depth]];
+		Axis axis = current.SplitAxis();
+		cells[depth + 1] = cells[depth];
+		if (coords[axis] < current.split) {
+			cells[depth + 1].hi[axis] = current.split;
+			path[depth + 1] = current.LeftChild();
 		} else {
-			node = node->rightChild;
+			cells[depth + 1].lo[axis] = current.split;
+			path[depth + 1] = current.RightChild();
+		}
+		depth++;
+	}
+
+	//As in a scapegoat tree, only a path that has grown deeper than the depth limit looks
+	//for a subtree to rebuild, and the deepest alpha-unbalanced ancestor is the one rebuilt.
+	if (depth > DepthLimit(rootNode)) {
+		for (int i = depth - 1; i >= 0; i--) {
+			const Node& current = nodes[path[i]];
+			unsigned int larger = std::max(counts[current.LeftChild()], counts[current.RightChild()]);
+			if (larger > REBALANCE_ALPHA * counts[path[i]]) {
+				RebuildSubtree(path, i, cells[i]);
+				return;
+			}
+		}
+	}
+
+	//Overfull leaves are split, unless all their entries share one vertex position.
+	NodeIndex leafNode = path[depth];
+	if (counts[leafNode] > SplitCount(nodes[leafNode].LeafIndex()) && depth < maxDepth) {
+		const Cell& cell = cells[depth];
+		const DirectX::XMFLOAT3* first = nullptr;
+		for (unsigned int triangle : GetLeafTriangles(leafNode)) {
+			for (const DirectX::XMFLOAT3& v : (*triangleSource)[triangle].triangleVertices) {
+				if (!InsideCell(cell, v)) {
+					continue;
+				}
+				if (first == nullptr) {
+					first = &v;
+				} else if (v.x != first->x || v.y != first->y || v.z != first->z) {
+					RebuildSubtree(path, depth, cell);
+					return;
+				}
+			}
 		}
-		currentAxis = node->split.first;
 	}
-	return node;
 }
 
-std::vector<Triangle> Kdtree::SearchTri(Triangle triangle, Node * rootNode)
+void Kdtree::RebuildSubtree(const NodeIndex* path, int depth, const Cell& cell)
 {
-	std::vector<Triangle> triangles = {};
-	std::vector<Node*> nodes;
-	Node* node;
+	NodeIndex node = path[depth];
+	unsigned int oldCount = counts[node];
+	ScratchVector<unsigned int> entries(nodes.get_allocator());
+	unsigned int oldNodes = 0;
+	CollectEntries(node, entries, oldNodes);
+	garbageNodes += oldNodes;
 
-	for (DirectX::XMFLOAT3 vertex : triangle.triangleVertices) {
-		node = SearchPos(vertex, rootNode);
-		bool exists = false;
-		for (std::vector<Node*>::iterator it = nodes.begin(); it != nodes.end(); it++) {
-			if (*it == node)
-				exists = true;
+	//Each entry stands for the vertices of its triangle inside this cell. Splitting at the
+	//median of exactly those vertices, with the traversal's tie rule, balances the entry
+	//counts of the new subtree.
+	std::sort(entries.begin(), entries.end());
+	entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+
+	BuildData data(EXTENT, nodes.get_allocator());
+	ScratchVector<unsigned int> owners(nodes.get_allocator());
+	for (unsigned int t = 0; t < entries.size(); t++) {
+		for (const DirectX::XMFLOAT3& v : (*triangleSource)[entries[t]].triangleVertices) {
+			if (InsideCell(cell, v)) {
+				data.centroids.push_back(v);
+				owners.push_back(t);
+			}
 		}
-		if (!exists) {
-			nodes.push_back(node);
-			triangles.insert(triangles.end(), node->triangles.begin(), node->triangles.end());
+	}
+	ScratchVector<unsigned int> order(data.centroids.size(), 0, nodes.get_allocator());
+	for (unsigned int i = 0; i < order.size(); i++) {
+		order[i] = i;
+	}
+
+	NodeVector subtree(1, Node(), nodes.get_allocator());
+	subtree.reserve(2 * order.size() + 1);
+	BuildInPlace(data, order.data(), order.data() + order.size(), subtree, 0, depth, maxDepth);
+
+	NodeIndex firstNew = (NodeIndex)nodes.size();
+	Graft(nodes, node, subtree);
+	counts.resize(nodes.size());
+	counts[node] = 0;
+	for (NodeIndex i = node; i < nodes.size(); i = (i == node ? firstNew : i + 1)) {
+		if (nodes[i].IsLeaf()) {
+			nodes[i].tag = ((unsigned int)leaves.size() << INDEX_SHIFT) | LEAF;
+			LeafRange empty = { 0, 0, 0, 0 };
+			leaves.push_back(empty);
+		}
+		counts[i] = 0;
+	}
+
+	for (unsigned int i = 0; i < data.centroids.size(); i++) {
+		AddEntry(data.centroids[i], entries[owners[i]], node);
+	}
+	for (NodeIndex i = node; i < nodes.size(); i = (i == node ? firstNew : i + 1)) {
+		if (nodes[i].IsLeaf()) {
+			LeafRange& range = leaves[nodes[i].LeafIndex()];
+			range.filled = range.count;
 		}
 	}
-	return triangles;
+	//AddEntry only counts from node down. A triangle can end up in more or fewer of the
+	//new leaves than of the old ones, so the ancestors take the difference.
+	for (int i = 0; i < depth; i++) {
+		counts[path[i]] = counts[path[i]] - oldCount + counts[node];
+	}
+
+	if (garbageNodes > nodes.size() / 2) {
+		Compact();
+	}
+}
+
+void Kdtree::CollectEntries(NodeIndex node, ScratchVector<unsigned int>& entries, unsigned int& nodeCount)
+{
+	const Node current = nodes[node];
+	if (current.IsLeaf()) {
+		LeafRange& range = leaves[current.LeafIndex()];
+		entries.insert(entries.end(), leafTriangles.Begin(range), leafTriangles.End(range));
+		leafTriangles.Release(range);
+		return;
+	}
+	nodeCount += 2;
+	CollectEntries(current.LeftChild(), entries, nodeCount);
+	CollectEntries(current.RightChild(), entries, nodeCount);
+}
+
+void Kdtree::Compact()
+{
+	//Relays the reachable nodes out depth first, dropping subtrees replaced by rebuilds.
+	NodeVector packedNodes(2, Node(), nodes.get_allocator());
+	ScratchVector<unsigned int> packedCounts(2, 0, nodes.get_allocator());
+	ScratchVector<LeafRange> packedLeaves(nodes.get_allocator());
+	packedNodes.reserve(nodes.size() - garbageNodes);
+	packedCounts.reserve(nodes.size() - garbageNodes);
+	CompactNode(ROOT, ROOT, packedNodes, packedCounts, packedLeaves);
+
+	nodes.swap(packedNodes);
+	counts.swap(packedCounts);
+	leaves.swap(packedLeaves);
+	garbageNodes = 0;
+	leafTriangles.Compact(leaves);
+}
+
+void Kdtree::CompactNode(NodeIndex node, NodeIndex slot, NodeVector& packedNodes, ScratchVector<unsigned int>& packedCounts, ScratchVector<LeafRange>& packedLeaves)
+{
+	const Node current = nodes[node];
+	packedCounts[slot] = counts[node];
+	if (current.IsLeaf()) {
+		packedNodes[slot].split = 0.0f;
+		packedNodes[slot].tag = ((unsigned int)packedLeaves.size() << INDEX_SHIFT) | LEAF;
+		packedLeaves.push_back(leaves[current.LeafIndex()]);
+		return;
+	}
+	NodeIndex children = Split(packedNodes, slot, current.SplitAxis(), current.split);
+	packedCounts.resize(packedNodes.size());
+	CompactNode(current.LeftChild(), children, packedNodes, packedCounts, packedLeaves);
+	CompactNode(current.RightChild(), children + 1, packedNodes, packedCounts, packedLeaves);
 }
 
-void Kdtree::Insert(Triangle triangle, Node* rootNode)
+struct Kdtree::NeighbourQuery
 {
-	Node* currentNode;
-	for (DirectX::XMFLOAT3 vertex : triangle.triangleVertices) {
-		currentNode = SearchPos(vertex, rootNode);
-		currentNode->triangles.push_back(triangle);
+	//Starts at the root, whose cell is all of space, with no results.
+	NeighbourQuery(DirectX::XMFLOAT3 p, DistanceMetric metric, Neighbour* results, unsigned int capacity, bool nearest, float boundSq)
+		: point{ p.x, p.y, p.z }, pointVector(DirectX::XMLoadFloat3(&p)), metric(metric), results(results), capacity(capacity), count(0), nearest(nearest), boundSq(boundSq)
+	{
+		const float inf = std::numeric_limits<float>::infinity();
+		for (int axis = 0; axis < 3; axis++) {
+			cell.lo[axis] = -inf;
+			cell.hi[axis] = inf;
+		}
+#ifdef KDTREE_STATS
+		visitedNodes = 0;
+		candidates = 0;
+#endif
 	}
-	return;
+
+	float point[3];
+	DirectX::XMVECTOR pointVector;
+	DistanceMetric metric;
+	Neighbour* results;
+	unsigned int capacity;
+	unsigned int count;
+	//k-NN keeps results as a max-heap on distance and shrinks the bound as it fills;
+	//radius queries keep a fixed bound and append.
+	bool nearest;
+	float boundSq;
+	//Cell of the node being visited.
+	Cell cell;
+#ifdef KDTREE_STATS
+	unsigned int visitedNodes;
+	unsigned int candidates;
+#endif
+};
+
+static bool ByDistance(const Kdtree::Neighbour& a, const Kdtree::Neighbour& b)
+{
+	return a.distanceSq < b.distanceSq;
 }
 
+//Closest point on triangle abc to p, from Ericson, Real-Time Collision Detection 5.1.5.
+static DirectX::XMVECTOR ClosestPointOnTriangle(DirectX::FXMVECTOR p, DirectX::FXMVECTOR a, DirectX::FXMVECTOR b, DirectX::GXMVECTOR c)
+{
+	using namespace DirectX;
+	XMVECTOR ab = XMVectorSubtract(b, a);
+	XMVECTOR ac = XMVectorSubtract(c, a);
+	XMVECTOR ap = XMVectorSubtract(p, a);
+	float d1 = XMVectorGetX(XMVector3Dot(ab, ap));
+	float d2 = XMVectorGetX(XMVector3Dot(ac, ap));
+	if (d1 <= 0.0f && d2 <= 0.0f) return a;
+
+	XMVECTOR bp = XMVectorSubtract(p, b);
+	float d3 = XMVectorGetX(XMVector3Dot(ab, bp));
+	float d4 = XMVectorGetX(XMVector3Dot(ac, bp));
+	if (d3 >= 0.0f && d4 <= d3) return b;
+
+	float vc = d1 * d4 - d3 * d2;
+	if (vc <= 0.0f && d1 >= 0.0f && d3 <= 0.0f) {
+		return XMVectorMultiplyAdd(ab, XMVectorReplicate(d1 / (d1 - d3)), a);
+	}
+
+	XMVECTOR cp = XMVectorSubtract(p, c);
+	float d5 = XMVectorGetX(XMVector3Dot(ab, cp));
+	float d6 = XMVectorGetX(XMVector3Dot(ac, cp));
+	if (d6 >= 0.0f && d5 <= d6) return c;
+
+	float vb = d5 * d2 - d1 * d6;
+	if (vb <= 0.0f && d2 >= 0.0f && d6 <= 0.0f) {
+		return XMVectorMultiplyAdd(ac, XMVectorReplicate(d2 / (d2 - d6)), a);
+	}
 
+	float va = d3 * d6 - d5 * d4;
+	if (va <= 0.0f && (d4 - d3) >= 0.0f && (d5 - d6) >= 0.0f) {
+		return XMVectorMultiplyAdd(XMVectorSubtract(c, b), XMVectorReplicate((d4 - d3) / ((d4 - d3) + (d5 - d6))), b);
+	}
 
+	float denom = 1.0f / (va + vb + vc);
+	return XMVectorAdd(a, XMVectorAdd(XMVectorScale(ab, vb * denom), XMVectorScale(ac, vc * denom)));
+}
+
+unsigned int Kdtree::SearchNearest(DirectX::XMFLOAT3 point, unsigned int k, DistanceMetric metric, Neighbour* results, NodeIndex rootNode) const
+{
+	if (k == 0 || nodes.empty()) {
+		return 0;
+	}
+	NeighbourQuery query(point, metric, results, k, true, std::numeric_limits<float>::infinity());
+	float offset[3] = { 0.0f, 0.0f, 0.0f };
+	SearchNeighbours(query, rootNode, offset, 0.0f);
+	KDTREE_STAT(queryStats.Add(query.visitedNodes, query.candidates));
+	std::sort_heap(results, results + query.count, ByDistance);
+	return query.count;
+}
 
+unsigned int Kdtree::SearchRadius(DirectX::XMFLOAT3 point, float radius, DistanceMetric metric, Neighbour* results, unsigned int capacity, NodeIndex rootNode) const
+{
+	if (capacity == 0 || nodes.empty()) {
+		return 0;
+	}
+	NeighbourQuery query(point, metric, results, capacity, false, radius * radius);
+	float offset[3] = { 0.0f, 0.0f, 0.0f };
+	SearchNeighbours(query, rootNode, offset, 0.0f);
+	KDTREE_STAT(queryStats.Add(query.visitedNodes, query.candidates));
+	std::sort(results, results + query.count, ByDistance);
+	return query.count;
+}
+
+void Kdtree::SearchNeighbours(NeighbourQuery& query, NodeIndex node, float offset[3], float cellDistanceSq) const
+{
+	//Skip cells that cannot hold a vertex of any triangle closer than the current bound.
+	if (query.boundSq != std::numeric_limits<float>::infinity()) {
+		float reach = sqrtf(query.boundSq) + maxEdgeLength;
+		if (cellDistanceSq > reach * reach) {
+			return;
+		}
+	}
+
+	KDTREE_STAT(query.visitedNodes++);
+	const Node& current = nodes[node];
+	if (!current.IsLeaf()) {
+		//Visit the child holding the query point first. The far child's cell distance is
+		//updated incrementally by replacing this axis' offset with the distance to the plane.
+		Axis axis = current.SplitAxis();
+		float diff = query.point[axis] - current.split;
+		NodeIndex nearChild = diff < 0.0f ? current.LeftChild() : current.RightChild();
+		NodeIndex farChild = diff < 0.0f ? current.RightChild() : current.LeftChild();
+		float& nearBound = diff < 0.0f ? query.cell.hi[axis] : query.cell.lo[axis];
+		float& farBound = diff < 0.0f ? query.cell.lo[axis] : query.cell.hi[axis];
+
+		float previousBound = nearBound;
+		nearBound = current.split;
+		SearchNeighbours(query, nearChild, offset, cellDistanceSq);
+		nearBound = previousBound;
+
+		float previous = offset[axis];
+		previousBound = farBound;
+		offset[axis] = diff;
+		farBound = current.split;
+		SearchNeighbours(query, farChild, offset, cellDistanceSq - previous * previous + diff * diff);
+		offset[axis] = previous;
+		farBound = previousBound;
+		return;
+	}
+
+	KDTREE_STAT(query.candidates += GetLeafTriangles(node).size());
+	for (unsigned int index : GetLeafTriangles(node)) {
+		//A triangle is stored in every leaf holding one of its vertices, so the same index
+		//can be reached through up to three leaves. It is only taken from the leaf of its
+		//first vertex, which always holds it. Pruning that leaf is safe: its cell is then
+		//farther than the bound plus the longest edge, and so is every point of the triangle.
+		const Triangle& triangle = (*triangleSource)[index];
+		if (!InsideCell(query.cell, triangle.triangleVertices[0])) {
+			continue;
+		}
+		DirectX::XMVECTOR target;
+		if (query.metric == CENTROID) {
+			target = DirectX::XMLoadFloat3(&triangle.position);
+		} else {
+			target = ClosestPointOnTriangle(query.pointVector,
+				DirectX::XMLoadFloat3(&triangle.triangleVertices[0]),
+				DirectX::XMLoadFloat3(&triangle.triangleVertices[1]),
+				DirectX::XMLoadFloat3(&triangle.triangleVertices[2]));
+		}
+		float distanceSq = DirectX::XMVectorGetX(DirectX::XMVector3LengthSq(DirectX::XMVectorSubtract(target, query.pointVector)));
+		if (distanceSq > query.boundSq) {
+			continue;
+		}
+
+		Neighbour candidate = { index, distanceSq };
+		if (!query.nearest) {
+			if (query.count < query.capacity) {
+				query.results[query.count++] = candidate;
+			}
+			continue;
+		}
+		if (query.count < query.capacity) {
+			query.results[query.count++] = candidate;
+			std::push_heap(query.results, query.results + query.count, ByDistance);
+		} else if (distanceSq < query.results[0].distanceSq) {
+			std::pop_heap(query.results, query.results + query.count, ByDistance);
+			query.results[query.count - 1] = candidate;
+			std::push_heap(query.results, query.results + query.count, ByDistance);
+		}
+		if (query.count == query.capacity) {
+			query.boundSq = query.results[0].distanceSq;
+		}
+	}
+}
+
+Kdtree::QueryCost Kdtree::MeasureQueryCost(const ScratchVector<Triangle>& probes, NodeIndex rootNode) const
+{
+	//The same descent and leaves as SearchTri, without touching the shared query counters.
+	unsigned long long visited = 0;
+	unsigned long long candidates = 0;
+	for (const Triangle& triangle : probes) {
+		NodeIndex found[3];
+		unsigned int visitedNodes = 0;
+		unsigned int foundCount = FindLeaves(triangle, rootNode, found, visitedNodes);
+		visited += visitedNodes;
+		for (unsigned int i = 0; i < foundCount; i++) {
+			candidates += GetLeafTriangles(found[i]).size();
+		}
+	}
+
+	QueryCost cost = { 0.0, 0.0 };
+	if (!probes.empty()) {
+		cost.visitedNodes = (double)visited / probes.size();
+		cost.candidates = (double)candidates / probes.size();
+	}
+	return cost;
+}
+
+#ifdef KDTREE_STATS
+Kdtree::Stats Kdtree::GetStats() const
+{
+	Stats stats = {};
+	if (!nodes.empty()) {
+		GatherStats(ROOT, 0, stats);
+	}
+	stats.bytes = nodes.capacity() * sizeof(Node) + counts.capacity() * sizeof(unsigned int) +
+		leaves.capacity() * sizeof(LeafRange) + leafTriangles.Capacity() * sizeof(unsigned int);
+	stats.buildSeconds = buildSeconds;
+	stats.queries = queryStats.queries.load(std::memory_order_relaxed);
+	stats.visitedNodes = queryStats.visitedNodes.load(std::memory_order_relaxed);
+	stats.candidates = queryStats.candidates.load(std::memory_order_relaxed);
+	return stats;
+}
+
+void Kdtree::GatherStats(NodeIndex node, unsigned int depth, Stats& stats) const
+{
+	//Walks the reachable nodes only, so subtrees dropped by a rebuild are not counted.
+	stats.nodeCount++;
+	const Node& current = nodes[node];
+	if (!current.IsLeaf()) {
+		if (counts[node] != counts[current.LeftChild()] + counts[current.RightChild()]) {
+			stats.countErrors++;
+		}
+		GatherStats(current.LeftChild(), depth + 1, stats);
+		GatherStats(current.RightChild(), depth + 1, stats);
+		return;
+	}
+	unsigned int occupancy = leaves[current.LeafIndex()].count;
+	if (counts[node] != occupancy) {
+		stats.countErrors++;
+	}
+	if (stats.depthHistogram.size() <= depth) {
+		stats.depthHistogram.resize(depth + 1, 0);
+	}
+	if (stats.leafOccupancy.size() <= occupancy) {
+		stats.leafOccupancy.resize(occupancy + 1, 0);
+	}
+	stats.leafCount++;
+	stats.depthHistogram[depth]++;
+	stats.leafOccupancy[occupancy]++;
+}
+#endif
@@ -1,42 +1,315 @@
 #pragma once
 
 #include "Triangle.h"
+#include "ScratchArena.h"
+#include "IndexStorage.h"
 #include <algorithm>
+#include <atomic>
+
+//Uncomment to collect build and query statistics. When it is not defined the counters
+//and the statistics API are compiled out entirely.
+//#define KDTREE_STATS
 
 using namespace DirectX;
 
 class Kdtree
 {
 public:
-	Kdtree() {}
-	~Kdtree() {
-		for (Node* node : nodes) {
-			delete node;
-		}
-	}
+	typedef unsigned int NodeIndex;
+
+	//All storage, build temporaries included, comes from arena when one is given. Memory
+	//released by updates is only reclaimed when the arena is reset, so a tree that is
+	//updated for a long time should use the heap.
+	explicit Kdtree(ScratchArena* arena = nullptr) : nodes(arena), counts(arena), leaves(arena), leafTriangles(arena) {}
 
 	enum Axis {
 		X = 0, Y = 1, Z = 2
 	};
 
-	enum NodeType{
-		SPLIT, LEAF
+	//All nodes live in one contiguous array. A node is packed into 8 bytes: the split
+	//position and a tag holding the split axis (or LEAF) in the low 2 bits and the index
+	//of the first child (or of the leaf bucket) in the upper 30 bits. Children are
+	//allocated as adjacent pairs on a 16-byte boundary, so one level of traversal reads
+	//a single cache line.
+	struct Node
+	{
+		float split;
+		unsigned int tag;
+
+		bool IsLeaf() const { return (tag & AXIS_MASK) == LEAF; }
+		Axis SplitAxis() const { return Axis(tag & AXIS_MASK); }
+		NodeIndex LeftChild() const { return tag >> INDEX_SHIFT; }
+		NodeIndex RightChild() const { return (tag >> INDEX_SHIFT) + 1; }
+		unsigned int LeafIndex() const { return tag >> INDEX_SHIFT; }
 	};
 
-	struct Node
+	//SORT_COPY is the original builder: full sort per level and a copy of each half.
+	//IN_PLACE partitions a single index array around the median with nth_element, so
+	//each level is linear and no triangles are copied.
+	enum BuildMode {
+		SORT_COPY, IN_PLACE
+	};
+
+	//MEDIAN cycles the axis with depth and splits at the centroid median. SAH bins the
+	//centroids along all three axes and picks the axis and plane with the lowest surface
+	//area cost, so large flat walls and floors are cut into well shaped cells. EXTENT
+	//splits the axis along which the centroids spread most at their median, keeping ties
+	//on the upper side as traversal does, and makes a leaf of centroids that all coincide.
+	//SAH and EXTENT only apply to IN_PLACE builds. Subtree rebuilds during updates always
+	//use EXTENT, since the vertices they split repeat the same coordinates many times.
+	enum SplitStrategy {
+		MEDIAN, SAH, EXTENT
+	};
+
+	//Average work done per SearchTri call over a set of probe triangles.
+	struct QueryCost
+	{
+		double visitedNodes;
+		double candidates;
+	};
+
+	//Distance used by the neighbour queries: to the triangle centroid, or to the closest
+	//point on the triangle itself.
+	enum DistanceMetric {
+		CENTROID, SURFACE
+	};
+
+	struct Neighbour
+	{
+		unsigned int triangle;
+		float distanceSq;
+	};
+
+	//Contiguous run of triangle indices inside the leaf storage.
+	struct IndexSpan
 	{
-		NodeType type;
-		std::pair<Axis, float> split;
-		Node* leftChild = nullptr;
-		Node* rightChild = nullptr;
-		std::vector<Triangle> triangles;
+		const unsigned int* first;
+		const unsigned int* last;
+
+		const unsigned int* begin() const { return first; }
+		const unsigned int* end() const { return last; }
+		unsigned int size() const { return (unsigned int)(last - first); }
 	};
 
-	Node* Create(std::vector<Triangle> triangles, int depth, int maxdepth);
-	Node* SearchPos(DirectX::XMFLOAT3 pos, Node* rootNode);
-	std::vector<Triangle> SearchTri(Triangle triangle, Node* rootNode);
-	void Insert(Triangle triangle, Node* rootNode);
+	static const NodeIndex ROOT = 0;
+
+	//Leaves store 32-bit indices into the triangle list given to Create, which must
+	//outlive the tree. Triangles appended to it later can be added with Insert.
+	NodeIndex Create(const ScratchVector<Triangle>& triangles, int depth, int maxdepth, BuildMode buildMode = IN_PLACE);
+
+	//IN_PLACE builds fork the two subtrees of every node shallower than parallelDepth onto
+	//the PPL worker pool, as long as the node holds at least sequentialCutoff triangles.
+	//The resulting node array is identical to a serial build.
+	void SetParallelBuild(int parallelDepth, unsigned int sequentialCutoff);
+	void SetSplitStrategy(SplitStrategy strategy) { splitStrategy = strategy; }
+
+	NodeIndex SearchPos(DirectX::XMFLOAT3 pos, NodeIndex rootNode) const;
+
+	//Writes one span per distinct leaf holding a vertex of the triangle (at most three)
+	//and returns how many were written. Spans stay valid until the next update.
+	unsigned int SearchTri(const Triangle& triangle, NodeIndex rootNode, IndexSpan spans[3]) const;
+
+	//Batched point location: descends four points at a time with XMVECTOR compares and
+	//writes the leaf node of every point to leafNodes. Matches SearchPos exactly.
+	void SearchPos(const DirectX::XMFLOAT3* points, unsigned int count, NodeIndex rootNode, NodeIndex* leafNodes) const;
+
+	//Adds triangles by index, which must not be in the tree already. Each is stored once
+	//in every distinct leaf holding one of its vertices. Filling an empty tree lays the leaves out as one compressed-sparse-row
+	//array in two passes (count, then fill); InsertAll does that for the whole list.
+	void Insert(unsigned int triangle, NodeIndex rootNode);
+	void Insert(const std::vector<unsigned int>& triangles, NodeIndex rootNode);
+	void InsertAll(NodeIndex rootNode);
+
+	//Incremental updates. A removed triangle must still hold the vertices it was inserted
+	//with. Every node counts the vertex entries stored below it. When an update leaves a
+	//path deeper than the tree size allows, the deepest ancestor with more than
+	//REBALANCE_ALPHA of its entries on one side is rebuilt with EXTENT splits over its own
+	//entries (a scapegoat rebuild); leaves that doubled from their filled size are split
+	//the same way. Updating k triangles costs O(k log n) plus the rebuilt subtrees: about
+	//twice k/n of a full build when they go back where the tree already has nodes, and
+	//more when they extend it into new space. A batch of more than REBUILD_FRACTION of the
+	//tree rebuilds it over its triangles instead, for about the cost of Create and
+	//InsertAll. Leaf node indices obtained earlier are invalidated by any update.
+	bool Remove(unsigned int triangle, NodeIndex rootNode);
+	void Remove(const std::vector<unsigned int>& triangles, NodeIndex rootNode);
+
+	//Neighbour queries write into a caller supplied buffer and never allocate. Results are
+	//sorted by ascending distance and hold triangle indices. SearchNearest returns the k
+	//closest triangles (fewer if the tree holds fewer); SearchRadius returns the triangles
+	//within radius, truncated to capacity. The traversal is a depth-first descent into the
+	//nearer child first, not a best-first priority queue: the queue would need a buffer of
+	//its own, while the recursion is bounded by the tree depth, and the nearest leaves
+	//still tighten the k-NN bound before any farther cell is tested.
+	unsigned int SearchNearest(DirectX::XMFLOAT3 point, unsigned int k, DistanceMetric metric, Neighbour* results, NodeIndex rootNode) const;
+	unsigned int SearchRadius(DirectX::XMFLOAT3 point, float radius, DistanceMetric metric, Neighbour* results, unsigned int capacity, NodeIndex rootNode) const;
+
+	QueryCost MeasureQueryCost(const ScratchVector<Triangle>& probes, NodeIndex rootNode) const;
+
+#ifdef KDTREE_STATS
+	//Histograms are indexed by leaf depth and by triangles per leaf. Query counters cover
+	//SearchTri, SearchNearest and SearchRadius since the last Create or ResetQueryStats.
+	//countErrors is the number of nodes whose entry count is not the number of entries
+	//stored below them, and stays zero unless the update bookkeeping is broken.
+	struct Stats
+	{
+		unsigned int nodeCount;
+		unsigned int leafCount;
+		unsigned int countErrors;
+		std::vector<unsigned int> depthHistogram;
+		std::vector<unsigned int> leafOccupancy;
+		size_t bytes;
+		double buildSeconds;
+		unsigned long long queries;
+		unsigned long long visitedNodes;
+		unsigned long long candidates;
+	};
+
+	Stats GetStats() const;
+	void ResetQueryStats() { queryStats.Reset(); }
+#endif
+
+	const Node& GetNode(NodeIndex node) const { return nodes[node]; }
+	const Triangle& GetTriangle(unsigned int triangle) const { return (*triangleSource)[triangle]; }
+	IndexSpan GetLeafTriangles(NodeIndex leafNode) const;
+
 private:
-	std::vector<Node*> nodes;
+	static const unsigned int AXIS_MASK = 0x3;
+	static const unsigned int LEAF = 0x3;
+	static const unsigned int INDEX_SHIFT = 2;
+
+	static const int MAX_DEPTH = 128;
+	static const unsigned int LEAF_MAX_ENTRIES = 12;
+	static const float REBALANCE_ALPHA;
+	static const float REBUILD_FRACTION;
+
+	//Node storage starts on a 16-byte boundary, in the arena and on the heap alike. The
+	//root and a padding slot fill the first block and every later sibling pair one more.
+	typedef std::vector<Node, ArenaAllocator<Node, 16>> NodeVector;
+
+	struct Bounds
+	{
+		DirectX::XMFLOAT3 min;
+		DirectX::XMFLOAT3 max;
+	};
+
+	//Per-triangle data gathered once for an IN_PLACE build.
+	struct BuildData
+	{
+		BuildData(SplitStrategy strategy, const ArenaAllocator<Node>& allocator) :
+			strategy(strategy), centroids(allocator), bounds(allocator) {}
+
+		SplitStrategy strategy;
+		ScratchVector<DirectX::XMFLOAT3> centroids;
+		ScratchVector<Bounds> bounds;
+	};
+
+	//Range of a leaf inside leafTriangles, packed and grown as PackedRanges describes.
+	//filled is the entry count left by the bulk insert or rebuild that filled the leaf.
+	struct LeafRange
+	{
+		unsigned int offset;
+		unsigned int count;
+		unsigned int capacity;
+		unsigned int filled;
+	};
+
+	//Half-open cell of a node: lo <= p < hi on every axis.
+	struct Cell
+	{
+		float lo[3];
+		float hi[3];
+	};
+	static bool InsideCell(const Cell& cell, const DirectX::XMFLOAT3& v);
+
+	void Build(ScratchVector<Triangle>& triangles, NodeIndex node, int depth, int maxdepth);
+	void BuildInPlace(const BuildData& data, unsigned int* first, unsigned int* last, NodeVector& out, NodeIndex node, int depth, int maxdepth) const;
+	unsigned int* PartitionMedian(const BuildData& data, unsigned int* first, unsigned int* last, int depth, Axis& axis, float& split) const;
+	unsigned int* PartitionExtent(const BuildData& data, unsigned int* first, unsigned int* last, Axis& axis, float& split) const;
+	bool FindSAHSplit(const BuildData& data, const unsigned int* first, const unsigned int* last, Axis& axis, float& split, bool& makeLeaf) const;
+	void BuildNodes(unsigned int* first, unsigned int* last, int depth);
+	void NumberLeaves();
+	void SearchPos4(const DirectX::XMFLOAT3* points, NodeIndex rootNode, NodeIndex* leafNodes) const;
+	//The distinct leaves holding the vertices of a triangle, as SearchTri and
+	//MeasureQueryCost see them. Adds the nodes on the three paths to visitedNodes.
+	unsigned int FindLeaves(const Triangle& triangle, NodeIndex rootNode, NodeIndex found[3], unsigned int& visitedNodes) const;
+
+	void InsertRange(const unsigned int* first, const unsigned int* last, NodeIndex rootNode);
+	void FillLeaves(const unsigned int* first, const unsigned int* last, NodeIndex rootNode);
+	//AddEntry returns whether the path now needs Rebalance; RemoveEntry returns the depth
+	//of the leaf the entry was removed from, or -1 when it was not there.
+	bool AddEntry(const DirectX::XMFLOAT3& vertex, unsigned int triangle, NodeIndex rootNode);
+	int RemoveEntry(const DirectX::XMFLOAT3& vertex, unsigned int triangle, NodeIndex rootNode);
+	float RebuildThreshold() const;
+	float DepthLimit(NodeIndex rootNode) const;
+	unsigned int SplitCount(unsigned int leaf) const;
+	void RebuildAll(const unsigned int* first, const unsigned int* last, bool insert);
+	void Rebalance(const DirectX::XMFLOAT3& vertex, NodeIndex rootNode);
+	void RebuildSubtree(const NodeIndex* path, int depth, const Cell& cell);
+	void CollectEntries(NodeIndex node, ScratchVector<unsigned int>& entries, unsigned int& nodeCount);
+	void Compact();
+	void CompactNode(NodeIndex node, NodeIndex slot, NodeVector& packedNodes, ScratchVector<unsigned int>& packedCounts, ScratchVector<LeafRange>& packedLeaves);
+
+#ifdef KDTREE_STATS
+	//A query counts into locals and adds them once at the end, with relaxed atomics, so
+	//the chunks searching one tree concurrently lose no counts. The three counters still
+	//share one line that every query writes, which the chunks contend for once per query;
+	//that is small next to the descent itself and only in KDTREE_STATS builds.
+	struct QueryStats
+	{
+		std::atomic<unsigned long long> queries;
+		std::atomic<unsigned long long> visitedNodes;
+		std::atomic<unsigned long long> candidates;
+
+		QueryStats() { Reset(); }
+
+		void Reset()
+		{
+			queries.store(0, std::memory_order_relaxed);
+			visitedNodes.store(0, std::memory_order_relaxed);
+			candidates.store(0, std::memory_order_relaxed);
+		}
+
+		void Add(unsigned long long visited, unsigned long long found)
+		{
+			queries.fetch_add(1, std::memory_order_relaxed);
+			visitedNodes.fetch_add(visited, std::memory_order_relaxed);
+			candidates.fetch_add(found, std::memory_order_relaxed);
+		}
+	};
+	void GatherStats(NodeIndex node, unsigned int depth, Stats& stats) const;
+#endif
+
+	struct NeighbourQuery;
+	void SearchNeighbours(NeighbourQuery& query, NodeIndex node, float offset[3], float cellDistanceSq) const;
+
+	static NodeIndex Split(NodeVector& out, NodeIndex node, Axis axis, float split);
+	static void MakeLeaf(NodeVector& out, NodeIndex node);
+	static void Graft(NodeVector& out, NodeIndex slot, const NodeVector& subtree);
+
+	SplitStrategy splitStrategy = MEDIAN;
+	int parallelDepth = 4;
+	unsigned int sequentialCutoff = 4096;
+
+	//A triangle is stored in the leaves holding its vertices, and every point of it lies
+	//within its longest edge of one of them. Neighbour queries widen their pruning
+	//distance by the longest edge inserted so far to stay exact.
+	float maxEdgeLength = 0.0f;
+
+	int maxDepth = MAX_DEPTH;
+	unsigned int garbageNodes = 0;
+	unsigned int liveTriangles = 0;
+	unsigned int builtTriangles = 0;
+
+	const ScratchVector<Triangle>* triangleSource = nullptr;
+
+	NodeVector nodes;
+	ScratchVector<unsigned int> counts;
+	ScratchVector<LeafRange> leaves;
+	PackedRanges leafTriangles;
+
+#ifdef KDTREE_STATS
+	double buildSeconds = 0.0;
+	mutable QueryStats queryStats;
+#endif
 };
 
@@ -0,0 +1,55 @@
+#include "pch.h"
+#include "MeshDecode.h"
+
+using namespace DirectX;
+using namespace DirectX::PackedVector;
+
+//Packs the xyz of four vectors into twelve consecutive floats.
+static void XM_CALLCONV StoreFloat3x4(XMFLOAT3* destination, FXMVECTOR v0, FXMVECTOR v1, FXMVECTOR v2, GXMVECTOR v3)
+{
+	XMFLOAT4* packed = (XMFLOAT4*)destination;
+	XMStoreFloat4(&packed[0], XMVectorPermute<XM_PERMUTE_0X, XM_PERMUTE_0Y, XM_PERMUTE_0Z, XM_PERMUTE_1X>(v0, v1));
+	XMStoreFloat4(&packed[1], XMVectorPermute<XM_PERMUTE_0Y, XM_PERMUTE_0Z, XM_PERMUTE_1X, XM_PERMUTE_1Y>(v1, v2));
+	XMStoreFloat4(&packed[2], XMVectorPermute<XM_PERMUTE_0Z, XM_PERMUTE_1X, XM_PERMUTE_1Y, XM_PERMUTE_1Z>(v2, v3));
+}
+
+void DecodePositions(const XMSHORTN4* positions, unsigned int count, const XMFLOAT3& scale, XMFLOAT3* decoded)
+{
+	XMVECTOR scaleVector = XMLoadFloat3(&scale);
+	unsigned int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		StoreFloat3x4(&decoded[i],
+			XMVectorMultiply(XMLoadShortN4(&positions[i]), scaleVector),
+			XMVectorMultiply(XMLoadShortN4(&positions[i + 1]), scaleVector),
+			XMVectorMultiply(XMLoadShortN4(&positions[i + 2]), scaleVector),
+			XMVectorMultiply(XMLoadShortN4(&positions[i + 3]), scaleVector));
+	}
+	for (; i < count; i++) {
+		XMStoreFloat3(&decoded[i], XMVectorMultiply(XMLoadShortN4(&positions[i]), scaleVector));
+	}
+}
+
+void DecodeNormals(const XMBYTEN4* normals, unsigned int count, XMFLOAT3* decoded)
+{
+	unsigned int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		StoreFloat3x4(&decoded[i],
+			XMLoadByteN4(&normals[i]), XMLoadByteN4(&normals[i + 1]), XMLoadByteN4(&normals[i + 2]), XMLoadByteN4(&normals[i + 3]));
+	}
+	for (; i < count; i++) {
+		XMStoreFloat3(&decoded[i], XMLoadByteN4(&normals[i]));
+	}
+}
+
+void DecodeIndices(const unsigned short* indices, unsigned int count, unsigned int* decoded)
+{
+	//A plain widening loop, which the compiler turns into zero-extending vector moves.
+	for (unsigned int i = 0; i < count; i++) {
+		decoded[i] = indices[i];
+	}
+}
+
+void DecodeIndices(const unsigned int* indices, unsigned int count, unsigned int* decoded)
+{
+	memcpy(decoded, indices, count * sizeof(unsigned int));
+}
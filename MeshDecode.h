@@ -0,0 +1,18 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+
+//Bulk conversion of the packed buffers of a spatial surface into preallocated arrays.
+//Four elements are decoded per step and written back as three full XMVECTOR stores, so
+//there is no per-element call, bounds check or reallocation.
+
+//R16G16B16A16_SNORM positions, multiplied by the surface's VertexPositionScale.
+void DecodePositions(const DirectX::PackedVector::XMSHORTN4* positions, unsigned int count, const DirectX::XMFLOAT3& scale, DirectX::XMFLOAT3* decoded);
+
+//R8G8B8A8_SNORM normals.
+void DecodeNormals(const DirectX::PackedVector::XMBYTEN4* normals, unsigned int count, DirectX::XMFLOAT3* decoded);
+
+//R16_UINT indices widened to 32 bits, or R32_UINT indices copied.
+void DecodeIndices(const unsigned short* indices, unsigned int count, unsigned int* decoded);
+void DecodeIndices(const unsigned int* indices, unsigned int count, unsigned int* decoded);
@@ -0,0 +1,123 @@
+#pragma once
+
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+
+//Typed access to the vertex and index buffers of a spatial surface without copying them.
+//Each stream is a base pointer, an element count, a byte stride and a format, as the
+//buffers come out of GetDataFromIBuffer, and elements are decoded only when they are
+//read. Nothing here depends on WinRT, so a view can be laid over any byte array.
+class MeshView
+{
+public:
+	//The UNSUPPORTED values stand for any other buffer format, which the view cannot read.
+	enum PositionFormat { POSITION_SNORM16, POSITION_FLOAT32, POSITION_UNSUPPORTED };
+	enum NormalFormat { NORMAL_SNORM8, NORMAL_FLOAT32, NORMAL_UNSUPPORTED };
+	enum IndexFormat { INDEX_UINT16, INDEX_UINT32, INDEX_UNSUPPORTED };
+
+	MeshView() {}
+
+	//scale is applied to every decoded position, as VertexPositionScale requires.
+	void SetPositions(const void* data, unsigned int count, unsigned int stride, PositionFormat format, const DirectX::XMFLOAT3& scale)
+	{
+		positions = (const unsigned char*)data;
+		vertexCount = count;
+		positionStride = stride;
+		positionFormat = format;
+		positionScale = scale;
+	}
+
+	void SetNormals(const void* data, unsigned int count, unsigned int stride, NormalFormat format)
+	{
+		normals = (const unsigned char*)data;
+		normalCount = count;
+		normalStride = stride;
+		normalFormat = format;
+	}
+
+	void SetIndices(const void* data, unsigned int count, IndexFormat format)
+	{
+		indices = (const unsigned char*)data;
+		indexCount = count;
+		indexFormat = format;
+	}
+
+	//Whether every stream has a supported format and a stride that holds its elements.
+	//Nothing else may be read from a view that is not.
+	bool IsSupported() const
+	{
+		unsigned int positionSize = positionFormat == POSITION_SNORM16 ? 8 : 12;
+		unsigned int normalSize = normalFormat == NORMAL_SNORM8 ? 4 : 12;
+		return positionFormat != POSITION_UNSUPPORTED && normalFormat != NORMAL_UNSUPPORTED && indexFormat != INDEX_UNSUPPORTED &&
+			positionStride >= positionSize && normalStride >= normalSize;
+	}
+
+	unsigned int VertexCount() const { return vertexCount; }
+	unsigned int NormalCount() const { return normalCount; }
+	unsigned int IndexCount() const { return indexCount; }
+	unsigned int TriangleCount() const { return indexCount / 3; }
+	IndexFormat GetIndexFormat() const { return indexFormat; }
+
+	DirectX::XMFLOAT3 Position(unsigned int vertex) const
+	{
+		const unsigned char* element = positions + (size_t)vertex * positionStride;
+		DirectX::XMVECTOR position = positionFormat == POSITION_FLOAT32 ?
+			DirectX::XMLoadFloat3((const DirectX::XMFLOAT3*)element) :
+			DirectX::PackedVector::XMLoadShortN4((const DirectX::PackedVector::XMSHORTN4*)element);
+		DirectX::XMFLOAT3 decoded;
+		DirectX::XMStoreFloat3(&decoded, DirectX::XMVectorMultiply(position, DirectX::XMLoadFloat3(&positionScale)));
+		return decoded;
+	}
+
+	DirectX::XMFLOAT3 Normal(unsigned int vertex) const
+	{
+		const unsigned char* element = normals + (size_t)vertex * normalStride;
+		if (normalFormat == NORMAL_FLOAT32) {
+			return *(const DirectX::XMFLOAT3*)element;
+		}
+		DirectX::XMFLOAT3 decoded;
+		DirectX::XMStoreFloat3(&decoded, DirectX::PackedVector::XMLoadByteN4((const DirectX::PackedVector::XMBYTEN4*)element));
+		return decoded;
+	}
+
+	unsigned int Index(unsigned int i) const
+	{
+		return indexFormat == INDEX_UINT16 ? ((const unsigned short*)indices)[i] : ((const unsigned int*)indices)[i];
+	}
+
+	//The positions as packed SNORM16 elements, or nullptr when they are stored otherwise.
+	const DirectX::PackedVector::XMSHORTN4* PackedPositions() const
+	{
+		return positionFormat == POSITION_SNORM16 && positionStride == sizeof(DirectX::PackedVector::XMSHORTN4) ?
+			(const DirectX::PackedVector::XMSHORTN4*)positions : nullptr;
+	}
+
+	//The normals as packed SNORM8 elements, or nullptr when they are stored otherwise.
+	const DirectX::PackedVector::XMBYTEN4* PackedNormals() const
+	{
+		return normalFormat == NORMAL_SNORM8 && normalStride == sizeof(DirectX::PackedVector::XMBYTEN4) ?
+			(const DirectX::PackedVector::XMBYTEN4*)normals : nullptr;
+	}
+
+	//The index buffer as IndexType, which must be unsigned short for INDEX_UINT16 and
+	//unsigned int for INDEX_UINT32. Loops that are specialised on the index width read
+	//through this instead of Index.
+	template <class IndexType>
+	const IndexType* GetIndices() const { return (const IndexType*)indices; }
+
+private:
+	const unsigned char* positions = nullptr;
+	unsigned int vertexCount = 0;
+	unsigned int positionStride = 0;
+	PositionFormat positionFormat = POSITION_UNSUPPORTED;
+	DirectX::XMFLOAT3 positionScale = DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f);
+
+	const unsigned char* normals = nullptr;
+	unsigned int normalCount = 0;
+	unsigned int normalStride = 0;
+	NormalFormat normalFormat = NORMAL_UNSUPPORTED;
+
+	const unsigned char* indices = nullptr;
+	unsigned int indexCount = 0;
+	IndexFormat indexFormat = INDEX_UNSUPPORTED;
+};
@@ -0,0 +1,29 @@
+#include "pch.h"
+#include "QuantizedWeld.h"
+#include "IndexStorage.h"
+
+void QuantizedWeld::Build(const DirectX::PackedVector::XMSHORTN4* positions, unsigned int count)
+{
+	//Keys use 48 bits, so all ones marks an empty slot. Open addressing with linear
+	//probing at a load factor of at most one half.
+	const unsigned long long emptyKey = ~0ull;
+	unsigned int tableMask = HashTableMask(2 * count);
+	tableKeys.assign(tableMask + 1, emptyKey);
+	tableIds.resize(tableMask + 1);
+	remap.resize(count);
+	representatives.clear();
+
+	for (unsigned int v = 0; v < count; v++) {
+		unsigned long long key = PositionKey(positions[v]);
+		unsigned int slot = HashSlot(key, tableMask);
+		while (tableKeys[slot] != emptyKey && tableKeys[slot] != key) {
+			slot = (slot + 1) & tableMask;
+		}
+		if (tableKeys[slot] == emptyKey) {
+			tableKeys[slot] = key;
+			tableIds[slot] = (unsigned int)representatives.size();
+			representatives.push_back(v);
+		}
+		remap[v] = tableIds[slot];
+	}
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "ScratchArena.h"
+#include <DirectXPackedVector.h>
+
+//Exact vertex welding on the raw XMSHORTN4 positions of a spatial surface. The three
+//16-bit components are packed into one 64-bit key and hashed, so vertices are matched
+//without decoding a single float. Welded vertex ids are numbered in order of first
+//appearance, and each keeps the first original vertex that produced it.
+class QuantizedWeld
+{
+public:
+	explicit QuantizedWeld(ScratchArena* arena = nullptr) :
+		remap(arena), representatives(arena), tableKeys(arena), tableIds(arena) {}
+
+	//SNORM decodes -32768 and -32767 both to -1, so they share a key and positions equal
+	//after decoding always weld.
+	static unsigned long long PositionKey(const DirectX::PackedVector::XMSHORTN4& position)
+	{
+		return ((unsigned long long)Component(position.x) << 32) |
+			((unsigned long long)Component(position.y) << 16) |
+			(unsigned long long)Component(position.z);
+	}
+
+	void Build(const DirectX::PackedVector::XMSHORTN4* positions, unsigned int count);
+
+	unsigned int WeldedCount() const { return (unsigned int)representatives.size(); }
+	unsigned int MergedCount() const { return (unsigned int)(remap.size() - representatives.size()); }
+	unsigned int Welded(unsigned int vertex) const { return remap[vertex]; }
+	unsigned int Representative(unsigned int weldedVertex) const { return representatives[weldedVertex]; }
+
+private:
+	static unsigned short Component(short value) { return (unsigned short)(value == -32768 ? -32767 : value); }
+
+	ScratchVector<unsigned int> remap;
+	ScratchVector<unsigned int> representatives;
+	ScratchVector<unsigned long long> tableKeys;
+	ScratchVector<unsigned int> tableIds;
+};
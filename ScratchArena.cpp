@@ -0,0 +1,90 @@
+#include "pch.h"
+#include "ScratchArena.h"
+#include <algorithm>
+
+ScratchArena::~ScratchArena()
+{
+	for (const Block& block : blocks)
+		::operator delete(block.data);
+}
+
+void ScratchArena::AddBlock(size_t size)
+{
+	blocks.push_back(Block{ (unsigned char*)::operator new(size), size });
+	counters.systemAllocations++;
+	counters.capacity += size;
+}
+
+void* ScratchArena::Allocate(size_t bytes, size_t alignment)
+{
+	std::lock_guard<std::mutex> guard(lock);
+	counters.allocations++;
+	counters.bytes += bytes;
+
+	while (true) {
+		if (current < blocks.size()) {
+			const Block& block = blocks[current];
+			uintptr_t base = (uintptr_t)block.data;
+			size_t start = (size_t)(((base + offset + alignment - 1) & ~(uintptr_t)(alignment - 1)) - base);
+			if (start + bytes <= block.size) {
+				offset = start + bytes;
+				return block.data + start;
+			}
+			if (current + 1 < blocks.size()) {
+				current++;
+				offset = 0;
+				continue;
+			}
+		}
+		//Blocks at least double, so a large surface only adds a few of them.
+		size_t size = std::max(blockSize, bytes + alignment);
+		if (!blocks.empty())
+			size = std::max(size, 2 * blocks.back().size);
+		AddBlock(size);
+		current = blocks.size() - 1;
+		offset = 0;
+	}
+}
+
+void ScratchArena::Reset()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	size_t capacity = counters.capacity;
+	counters = Counters();
+	if (blocks.size() > 1) {
+		for (const Block& block : blocks)
+			::operator delete(block.data);
+		blocks.clear();
+		AddBlock(capacity);
+	} else {
+		counters.capacity = capacity;
+	}
+	current = 0;
+	offset = 0;
+}
+
+ScratchArena::Counters ScratchArena::GetCounters() const
+{
+	std::lock_guard<std::mutex> guard(lock);
+	return counters;
+}
+
+ScratchArena* ScratchArenaPool::Acquire()
+{
+	std::lock_guard<std::mutex> guard(lock);
+	if (idle.empty()) {
+		arenas.push_back(std::unique_ptr<ScratchArena>(new ScratchArena()));
+		idle.reserve(arenas.size());
+		return arenas.back().get();
+	}
+	ScratchArena* arena = idle.back();
+	idle.pop_back();
+	return arena;
+}
+
+void ScratchArenaPool::Release(ScratchArena* arena)
+{
+	arena->Reset();
+	std::lock_guard<std::mutex> guard(lock);
+	idle.push_back(arena);
+}
@@ -0,0 +1,148 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cstddef>
+#include <cstdint>
+
+//Monotonic memory for the scratch structures of one surface. Allocations are carved out
+//of a few large blocks and never freed one by one; Reset rewinds the arena and keeps the
+//blocks, so processing a stream of similar surfaces stops touching the heap once the
+//largest one has been seen. Allocation takes a lock, since the chunk workers of one
+//surface share its arena.
+class ScratchArena
+{
+public:
+	//allocations and bytes count everything handed out since the last Reset, including
+	//memory left behind by a growing vector. systemAllocations counts the blocks taken
+	//from the heap in the same period, a merge by Reset included, and is zero in steady
+	//state. capacity is the size of all blocks held.
+	struct Counters
+	{
+		unsigned int allocations;
+		size_t bytes;
+		unsigned int systemAllocations;
+		size_t capacity;
+	};
+
+	explicit ScratchArena(size_t blockSize = 1 << 20) : blockSize(blockSize) {}
+	~ScratchArena();
+
+	ScratchArena(const ScratchArena&) = delete;
+	ScratchArena& operator=(const ScratchArena&) = delete;
+
+	void* Allocate(size_t bytes, size_t alignment);
+
+	//Makes all memory available again and clears the counters. Blocks added since the
+	//previous Reset are merged into one, so the next surface of this size fits in a
+	//single block.
+	void Reset();
+
+	Counters GetCounters() const;
+
+private:
+	struct Block
+	{
+		unsigned char* data;
+		size_t size;
+	};
+
+	void AddBlock(size_t size);
+
+	size_t blockSize;
+	std::vector<Block> blocks;
+	size_t current = 0;
+	size_t offset = 0;
+	Counters counters = Counters();
+	mutable std::mutex lock;
+};
+
+//Standard allocator over a ScratchArena, in the manner of std::pmr::polymorphic_allocator.
+//Deallocation is a no-op, the memory is reclaimed by ScratchArena::Reset. Without an
+//arena it falls back to the heap, so a ScratchVector works anywhere a std::vector does.
+//Alignment can be raised above alignof(T) for storage that is read in wider blocks than
+//its elements; the heap fallback then over-allocates and keeps the original pointer just
+//before the aligned block.
+template <class T, size_t Alignment = alignof(T)>
+class ArenaAllocator
+{
+public:
+	typedef T value_type;
+
+	template <class U>
+	struct rebind
+	{
+		typedef ArenaAllocator<U, (Alignment > alignof(U) ? Alignment : alignof(U))> other;
+	};
+
+	ArenaAllocator(ScratchArena* arena = nullptr) : arena(arena) {}
+	template <class U, size_t OtherAlignment>
+	ArenaAllocator(const ArenaAllocator<U, OtherAlignment>& other) : arena(other.GetArena()) {}
+
+	T* allocate(size_t count)
+	{
+		if (arena)
+			return (T*)arena->Allocate(count * sizeof(T), Alignment);
+		if (Alignment <= alignof(std::max_align_t))
+			return (T*)::operator new(count * sizeof(T));
+		unsigned char* block = (unsigned char*)::operator new(count * sizeof(T) + Alignment + sizeof(void*));
+		uintptr_t aligned = ((uintptr_t)(block + sizeof(void*)) + Alignment - 1) & ~(uintptr_t)(Alignment - 1);
+		((void**)aligned)[-1] = block;
+		return (T*)aligned;
+	}
+
+	void deallocate(T* pointer, size_t)
+	{
+		if (arena)
+			return;
+		if (Alignment <= alignof(std::max_align_t))
+			::operator delete(pointer);
+		else
+			::operator delete(((void**)pointer)[-1]);
+	}
+
+	ScratchArena* GetArena() const { return arena; }
+
+private:
+	ScratchArena* arena;
+};
+
+template <class T, size_t A, class U, size_t B>
+bool operator==(const ArenaAllocator<T, A>& a, const ArenaAllocator<U, B>& b) { return a.GetArena() == b.GetArena(); }
+template <class T, size_t A, class U, size_t B>
+bool operator!=(const ArenaAllocator<T, A>& a, const ArenaAllocator<U, B>& b) { return a.GetArena() != b.GetArena(); }
+
+template <class T>
+using ScratchVector = std::vector<T, ArenaAllocator<T>>;
+
+//Arenas for concurrent extraction jobs. Every job leases one arena for the surface it
+//works on, and a released arena is reset and handed to the next job, so the pool grows
+//to the number of surfaces processed at the same time.
+class ScratchArenaPool
+{
+public:
+	class Lease
+	{
+	public:
+		explicit Lease(ScratchArenaPool& pool) : pool(pool), arena(pool.Acquire()) {}
+		~Lease() { pool.Release(arena); }
+
+		Lease(const Lease&) = delete;
+		Lease& operator=(const Lease&) = delete;
+
+		ScratchArena* Get() const { return arena; }
+
+	private:
+		ScratchArenaPool& pool;
+		ScratchArena* arena;
+	};
+
+	ScratchArena* Acquire();
+	void Release(ScratchArena* arena);
+
+private:
+	std::mutex lock;
+	std::vector<std::unique_ptr<ScratchArena>> arenas;
+	std::vector<ScratchArena*> idle;
+};
@@ -0,0 +1,132 @@
+#include "pch.h"
+#include "SpatialGrid.h"
+
+void SpatialGrid::Create(const ScratchVector<Triangle>& triangles, float cellSize)
+{
+	triangleSource = &triangles;
+
+	if (!(cellSize > 0.0f)) {
+		double edgeSum = 0.0;
+		for (const Triangle& triangle : triangles) {
+			for (int i = 0; i < 3; i++) {
+				DirectX::XMVECTOR edge = DirectX::XMVectorSubtract(
+					DirectX::XMLoadFloat3(&triangle.triangleVertices[(i + 1) % 3]),
+					DirectX::XMLoadFloat3(&triangle.triangleVertices[i]));
+				edgeSum += DirectX::XMVectorGetX(DirectX::XMVector3Length(edge));
+			}
+		}
+		cellSize = triangles.empty() ? 0.0f : (float)(edgeSum / (3.0 * triangles.size()));
+		if (!(cellSize > 0.0f)) {
+			cellSize = 1.0f;
+		}
+	}
+	this->cellSize = cellSize;
+	inverseCellSize = 1.0f / cellSize;
+
+	//A closed mesh has about half as many vertices as triangles, and one cell per average
+	//edge holds about one vertex, so one bucket per triangle keeps collisions rare.
+	bucketMask = HashTableMask((unsigned int)triangles.size());
+	BucketRange empty = { 0, 0, 0 };
+	buckets.assign(bucketMask + 1, empty);
+	bucketTriangles.Clear();
+}
+
+unsigned int SpatialGrid::BucketOf(const DirectX::XMFLOAT3& v) const
+{
+	//Spatial hash of the integer cell coordinates (Teschner et al. 2003).
+	unsigned int x = (unsigned int)(int)floorf(v.x * inverseCellSize);
+	unsigned int y = (unsigned int)(int)floorf(v.y * inverseCellSize);
+	unsigned int z = (unsigned int)(int)floorf(v.z * inverseCellSize);
+	return ((x * 73856093u) ^ (y * 19349663u) ^ (z * 83492791u)) & bucketMask;
+}
+
+void SpatialGrid::InsertAll()
+{
+	const ScratchVector<Triangle>& triangles = *triangleSource;
+	const unsigned int skip = ~0u;
+	ScratchVector<unsigned int> vertexBuckets(3 * triangles.size(), 0, buckets.get_allocator());
+	for (unsigned int t = 0; t < triangles.size(); t++) {
+		unsigned int* bucket = &vertexBuckets[3 * t];
+		for (int i = 0; i < 3; i++) {
+			bucket[i] = BucketOf(triangles[t].triangleVertices[i]);
+		}
+		if (bucket[1] == bucket[0]) {
+			bucket[1] = skip;
+		}
+		if (bucket[2] == bucket[0] || bucket[2] == bucket[1]) {
+			bucket[2] = skip;
+		}
+	}
+
+	for (unsigned int bucket : vertexBuckets) {
+		if (bucket != skip) {
+			buckets[bucket].count++;
+		}
+	}
+	bucketTriangles.Layout(buckets);
+	for (unsigned int i = 0; i < vertexBuckets.size(); i++) {
+		if (vertexBuckets[i] != skip) {
+			bucketTriangles.Push(buckets[vertexBuckets[i]], i / 3);
+		}
+	}
+}
+
+void SpatialGrid::Insert(unsigned int triangle)
+{
+	unsigned int found[3];
+	unsigned int foundCount = 0;
+	for (const DirectX::XMFLOAT3& vertex : (*triangleSource)[triangle].triangleVertices) {
+		unsigned int bucket = BucketOf(vertex);
+		if (std::find(found, found + foundCount, bucket) == found + foundCount) {
+			found[foundCount++] = bucket;
+			bucketTriangles.Append(buckets, bucket, triangle);
+		}
+	}
+}
+
+bool SpatialGrid::Remove(unsigned int triangle)
+{
+	bool removed = false;
+	for (const DirectX::XMFLOAT3& vertex : (*triangleSource)[triangle].triangleVertices) {
+		if (bucketTriangles.Remove(buckets[BucketOf(vertex)], triangle)) {
+			removed = true;
+		}
+	}
+	return removed;
+}
+
+unsigned int SpatialGrid::SearchTri(const Triangle& triangle, IndexSpan spans[3]) const
+{
+	unsigned int found[3];
+	unsigned int foundCount = 0;
+	for (const DirectX::XMFLOAT3& vertex : triangle.triangleVertices) {
+		unsigned int bucket = BucketOf(vertex);
+		if (std::find(found, found + foundCount, bucket) == found + foundCount) {
+			spans[foundCount].first = bucketTriangles.Begin(buckets[bucket]);
+			spans[foundCount].last = bucketTriangles.End(buckets[bucket]);
+			found[foundCount++] = bucket;
+		}
+	}
+	return foundCount;
+}
+
+Kdtree::QueryCost SpatialGrid::MeasureQueryCost(const ScratchVector<Triangle>& probes) const
+{
+	unsigned long long visited = 0;
+	unsigned long long candidates = 0;
+	for (const Triangle& triangle : probes) {
+		IndexSpan spans[3];
+		unsigned int count = SearchTri(triangle, spans);
+		visited += 3;
+		for (unsigned int i = 0; i < count; i++) {
+			candidates += spans[i].size();
+		}
+	}
+
+	Kdtree::QueryCost cost = { 0.0, 0.0 };
+	if (!probes.empty()) {
+		cost.visitedNodes = (double)visited / probes.size();
+		cost.candidates = (double)candidates / probes.size();
+	}
+	return cost;
+}
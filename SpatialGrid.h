@@ -0,0 +1,56 @@
+#pragma once
+
+#include "Kdtree.h"
+
+//Uniform grid over the triangle vertices, hashed into a fixed table of buckets. Cells of
+//the side length of an average edge hold a handful of triangles, so a lookup is one hash
+//per vertex and inserting a triangle is O(1). Queries mirror Kdtree: a triangle is stored
+//once in every distinct bucket holding one of its vertices, and SearchTri returns those
+//buckets, so every triangle sharing a vertex is among the candidates. Cells that hash to
+//the same bucket share it, which only adds candidates.
+class SpatialGrid
+{
+public:
+	typedef Kdtree::IndexSpan IndexSpan;
+
+	explicit SpatialGrid(ScratchArena* arena = nullptr) : buckets(arena), bucketTriangles(arena) {}
+
+	//Buckets store 32-bit indices into triangles, which must outlive the grid. A cellSize
+	//of zero uses the average edge length of the triangles.
+	void Create(const ScratchVector<Triangle>& triangles, float cellSize = 0.0f);
+
+	//Fills an empty grid with every triangle in two passes (count, then fill), laying the
+	//buckets out back to back in one array.
+	void InsertAll();
+	void Insert(unsigned int triangle);
+	bool Remove(unsigned int triangle);
+
+	//Writes one span per distinct bucket holding a vertex of the triangle (at most three)
+	//and returns how many were written. Spans stay valid until the next update.
+	unsigned int SearchTri(const Triangle& triangle, IndexSpan spans[3]) const;
+
+	//Same measure as Kdtree::MeasureQueryCost; visitedNodes counts hashed buckets.
+	Kdtree::QueryCost MeasureQueryCost(const ScratchVector<Triangle>& probes) const;
+
+	float GetCellSize() const { return cellSize; }
+	const Triangle& GetTriangle(unsigned int triangle) const { return (*triangleSource)[triangle]; }
+
+private:
+	//Range of a bucket inside bucketTriangles, packed and grown by PackedRanges.
+	struct BucketRange
+	{
+		unsigned int offset;
+		unsigned int count;
+		unsigned int capacity;
+	};
+
+	unsigned int BucketOf(const DirectX::XMFLOAT3& v) const;
+
+	const ScratchVector<Triangle>* triangleSource = nullptr;
+	float cellSize = 1.0f;
+	float inverseCellSize = 1.0f;
+	unsigned int bucketMask = 0;
+
+	ScratchVector<BucketRange> buckets;
+	PackedRanges bucketTriangles;
+};
@@ -1,38 +1,75 @@
 #pragma once
-#include <vector>
+#include <type_traits>
 
-struct Triangle {
-	std::vector<DirectX::XMFLOAT3> triangleVertices;
-	std::vector<DirectX::XMFLOAT3> triangleNormals;
+//Plain data: fixed arrays instead of vectors, so building, copying and comparing triangles
+//never touches the heap. The face normal, area and centroid are computed once here.
+struct alignas(16) Triangle {
+	DirectX::XMFLOAT3 triangleVertices[3];
+	DirectX::XMFLOAT3 triangleNormals[3];
+	//Centroid
 	DirectX::XMFLOAT3 position;
+	//Unit normal of the face, wound v1 -> v2 -> v3. Zero for a degenerate triangle.
+	DirectX::XMFLOAT3 faceNormal;
+	float area;
+
+	Triangle() = default;
 
 	Triangle(DirectX::XMFLOAT3 v1, DirectX::XMFLOAT3 v2, DirectX::XMFLOAT3 v3, DirectX::XMFLOAT3 n1, DirectX::XMFLOAT3 n2, DirectX::XMFLOAT3 n3) {
-		triangleVertices.push_back(v1);
-		triangleVertices.push_back(v2);
-		triangleVertices.push_back(v3);
+		triangleVertices[0] = v1;
+		triangleVertices[1] = v2;
+		triangleVertices[2] = v3;
+		triangleNormals[0] = n1;
+		triangleNormals[1] = n2;
+		triangleNormals[2] = n3;
+		ComputeFaceData();
+	}
+
+	//Without vertex normals every vertex takes the face normal.
+	Triangle(const DirectX::XMFLOAT3 vertices[3]) {
+		for (int i = 0; i < 3; i++) {
+			triangleVertices[i] = vertices[i];
+		}
+		ComputeFaceData();
+		for (int i = 0; i < 3; i++) {
+			triangleNormals[i] = faceNormal;
+		}
+	}
+
+private:
+	void ComputeFaceData() {
+		const DirectX::XMFLOAT3& v1 = triangleVertices[0];
+		const DirectX::XMFLOAT3& v2 = triangleVertices[1];
+		const DirectX::XMFLOAT3& v3 = triangleVertices[2];
 		position = DirectX::XMFLOAT3(
 			(v1.x + v2.x + v3.x) / 3,
 			(v1.y + v2.y + v3.y) / 3,
 			(v1.z + v2.z + v3.z) / 3
 		);
-		triangleNormals.push_back(n1);
-		triangleNormals.push_back(n2);
-		triangleNormals.push_back(n3);
-	}
 
-	Triangle(std::vector<DirectX::XMFLOAT3> vertices) {
-		float xSum, ySum, zSum = 0.0f;
-		for (DirectX::XMFLOAT3 v : vertices) {
-			xSum += v.x;
-			ySum += v.y;
-			zSum += v.z;
-			triangleVertices.push_back(v);
-		}
-		position = DirectX::XMFLOAT3(
-			xSum/3,
-			ySum/3,
-			zSum/3
-		);
+		DirectX::XMVECTOR a = DirectX::XMLoadFloat3(&v1);
+		DirectX::XMVECTOR cross = DirectX::XMVector3Cross(
+			DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&v2), a),
+			DirectX::XMVectorSubtract(DirectX::XMLoadFloat3(&v3), a));
+		area = 0.5f * DirectX::XMVectorGetX(DirectX::XMVector3Length(cross));
+		DirectX::XMStoreFloat3(&faceNormal, DirectX::XMVector3Normalize(cross));
 	}
 };
 
+static_assert(std::is_trivially_copyable<Triangle>::value, "Triangle must stay plain data");
+static_assert(sizeof(Triangle) % 16 == 0, "Triangle must fill whole 16-byte blocks");
+
+//Positions compare exactly, as the spatial searches match shared vertices.
+inline bool operator==(const DirectX::XMFLOAT3& A, const DirectX::XMFLOAT3& B) {
+	return A.x == B.x && A.y == B.y && A.z == B.z;
+}
+inline bool operator!=(const DirectX::XMFLOAT3& A, const DirectX::XMFLOAT3& B) {
+	return !(A == B);
+}
+inline bool operator!=(const Triangle& A, const Triangle& B) {
+	for (unsigned int i = 0; i < 3; i++) {
+		if (A.triangleVertices[i] != B.triangleVertices[i]) {
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,155 @@
+#include "pch.h"
+#include "VertexWeld.h"
+#include "IndexStorage.h"
+#include <cstring>
+
+const unsigned int VertexWeld::NONE;
+
+static const unsigned long long EMPTY_KEY = ~0ull;
+
+//21 bits per axis around a bias, so the key of any cell within a kilometre of the origin
+//at millimetre cells is unique and never equals EMPTY_KEY.
+static unsigned long long CellKey(int x, int y, int z)
+{
+	const int bias = 1 << 20;
+	return ((unsigned long long)((x + bias) & 0x1FFFFF) << 42) |
+		((unsigned long long)((y + bias) & 0x1FFFFF) << 21) |
+		(unsigned long long)((z + bias) & 0x1FFFFF);
+}
+
+//Bits of a coordinate with -0 mapped to +0.
+static uint32_t CoordinateBits(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return bits == 0x80000000 ? 0 : bits;
+}
+
+//Mixes the three coordinates into a 63-bit hash, which never equals EMPTY_KEY.
+static unsigned long long PositionHash(const DirectX::XMFLOAT3& position)
+{
+	unsigned long long hash = CoordinateBits(position.x);
+	hash = (hash ^ CoordinateBits(position.y)) * FIBONACCI_MULTIPLIER;
+	hash = (hash ^ CoordinateBits(position.z)) * FIBONACCI_MULTIPLIER;
+	return (hash ^ (hash >> 29)) >> 1;
+}
+
+static bool SamePosition(const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b)
+{
+	return CoordinateBits(a.x) == CoordinateBits(b.x) && CoordinateBits(a.y) == CoordinateBits(b.y) && CoordinateBits(a.z) == CoordinateBits(b.z);
+}
+
+unsigned int VertexWeld::FindSlot(unsigned long long key) const
+{
+	unsigned int slot = HashSlot(key, tableMask);
+	while (tableKeys[slot] != EMPTY_KEY && tableKeys[slot] != key) {
+		slot = (slot + 1) & tableMask;
+	}
+	return slot;
+}
+
+void VertexWeld::Build(const DirectX::XMFLOAT3* positions, unsigned int count, float epsilon)
+{
+	using namespace DirectX;
+
+	if (epsilon <= 0.0f) {
+		BuildExact(positions, count);
+		return;
+	}
+
+	float inverseCell = 1.0f / epsilon;
+	cellX.resize(count);
+	cellY.resize(count);
+	cellZ.resize(count);
+
+	//Transpose four positions so that each register holds one axis of all lanes, then
+	//floor and convert a whole axis at once.
+	const XMVECTOR inverseCellVector = XMVectorReplicate(inverseCell);
+	unsigned int i = 0;
+	for (; i + 4 <= count; i += 4) {
+		XMMATRIX lanes = XMMatrixTranspose(XMMATRIX(
+			XMLoadFloat3(&positions[i]), XMLoadFloat3(&positions[i + 1]), XMLoadFloat3(&positions[i + 2]), XMLoadFloat3(&positions[i + 3])));
+		XMStoreInt4((uint32_t*)&cellX[i], XMConvertVectorFloatToInt(XMVectorFloor(XMVectorMultiply(lanes.r[0], inverseCellVector)), 0));
+		XMStoreInt4((uint32_t*)&cellY[i], XMConvertVectorFloatToInt(XMVectorFloor(XMVectorMultiply(lanes.r[1], inverseCellVector)), 0));
+		XMStoreInt4((uint32_t*)&cellZ[i], XMConvertVectorFloatToInt(XMVectorFloor(XMVectorMultiply(lanes.r[2], inverseCellVector)), 0));
+	}
+	for (; i < count; i++) {
+		cellX[i] = (int)floorf(positions[i].x * inverseCell);
+		cellY[i] = (int)floorf(positions[i].y * inverseCell);
+		cellZ[i] = (int)floorf(positions[i].z * inverseCell);
+	}
+
+	tableMask = HashTableMask(2 * count);
+	tableKeys.assign(tableMask + 1, EMPTY_KEY);
+	tableHeads.resize(tableMask + 1);
+	remap.resize(count);
+	representatives.clear();
+	nextInCell.clear();
+
+	const float epsilonSq = epsilon * epsilon;
+	for (unsigned int v = 0; v < count; v++) {
+		XMVECTOR position = XMLoadFloat3(&positions[v]);
+		unsigned int closest = NONE;
+		float closestSq = epsilonSq;
+		for (int dz = -1; dz <= 1; dz++) {
+			for (int dy = -1; dy <= 1; dy++) {
+				for (int dx = -1; dx <= 1; dx++) {
+					unsigned int slot = FindSlot(CellKey(cellX[v] + dx, cellY[v] + dy, cellZ[v] + dz));
+					if (tableKeys[slot] == EMPTY_KEY) {
+						continue;
+					}
+					for (unsigned int r = tableHeads[slot]; r != NONE; r = nextInCell[r]) {
+						XMVECTOR offset = XMVectorSubtract(XMLoadFloat3(&positions[representatives[r]]), position);
+						float distanceSq = XMVectorGetX(XMVector3LengthSq(offset));
+						if (distanceSq <= closestSq) {
+							closest = r;
+							closestSq = distanceSq;
+						}
+					}
+				}
+			}
+		}
+
+		if (closest == NONE) {
+			unsigned long long key = CellKey(cellX[v], cellY[v], cellZ[v]);
+			unsigned int slot = FindSlot(key);
+			closest = (unsigned int)representatives.size();
+			representatives.push_back(v);
+			if (tableKeys[slot] == EMPTY_KEY) {
+				tableKeys[slot] = key;
+				nextInCell.push_back(NONE);
+			} else {
+				nextInCell.push_back(tableHeads[slot]);
+			}
+			tableHeads[slot] = closest;
+		}
+		remap[v] = closest;
+	}
+}
+
+void VertexWeld::BuildExact(const DirectX::XMFLOAT3* positions, unsigned int count)
+{
+	//Slots hold the hash and the id of the first vertex with that position. Hashes can
+	//collide, so a matching hash is confirmed on the positions and probing goes on past it
+	//otherwise.
+	tableMask = HashTableMask(2 * count);
+	tableKeys.assign(tableMask + 1, EMPTY_KEY);
+	tableHeads.resize(tableMask + 1);
+	remap.resize(count);
+	representatives.clear();
+	nextInCell.clear();
+
+	for (unsigned int v = 0; v < count; v++) {
+		unsigned long long key = PositionHash(positions[v]);
+		unsigned int slot = HashSlot(key, tableMask);
+		while (tableKeys[slot] != EMPTY_KEY && (tableKeys[slot] != key || !SamePosition(positions[representatives[tableHeads[slot]]], positions[v]))) {
+			slot = (slot + 1) & tableMask;
+		}
+		if (tableKeys[slot] == EMPTY_KEY) {
+			tableKeys[slot] = key;
+			tableHeads[slot] = (unsigned int)representatives.size();
+			representatives.push_back(v);
+		}
+		remap[v] = tableHeads[slot];
+	}
+}
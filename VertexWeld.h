@@ -0,0 +1,44 @@
+#pragma once
+
+#include "ScratchArena.h"
+#include <DirectXMath.h>
+
+//Tolerance welding of decoded vertex positions. Every vertex is compared only with the
+//welded vertices of the 27 hash grid cells around it, with cells one epsilon wide, so the
+//pass is linear. A vertex joins the closest earlier representative within epsilon or
+//becomes a representative itself, so the result depends on vertex order but never chains
+//vertices further than epsilon from their representative. Cell coordinates are computed
+//four vertices at a time with XMVECTOR operations. With an epsilon of 0 there is no grid:
+//vertices weld only when their positions have the same bits, with -0 equal to +0.
+class VertexWeld
+{
+public:
+	explicit VertexWeld(ScratchArena* arena = nullptr) :
+		remap(arena), representatives(arena), nextInCell(arena), cellX(arena), cellY(arena), cellZ(arena), tableKeys(arena), tableHeads(arena) {}
+
+	void Build(const DirectX::XMFLOAT3* positions, unsigned int count, float epsilon);
+
+	unsigned int WeldedCount() const { return (unsigned int)representatives.size(); }
+	unsigned int MergedCount() const { return (unsigned int)(remap.size() - representatives.size()); }
+	unsigned int Welded(unsigned int vertex) const { return remap[vertex]; }
+	unsigned int Representative(unsigned int weldedVertex) const { return representatives[weldedVertex]; }
+
+private:
+	static const unsigned int NONE = 0xFFFFFFFF;
+
+	unsigned int FindSlot(unsigned long long key) const;
+	void BuildExact(const DirectX::XMFLOAT3* positions, unsigned int count);
+
+	ScratchVector<unsigned int> remap;
+	ScratchVector<unsigned int> representatives;
+	//Next representative in the same cell.
+	ScratchVector<unsigned int> nextInCell;
+
+	ScratchVector<int> cellX;
+	ScratchVector<int> cellY;
+	ScratchVector<int> cellZ;
+
+	ScratchVector<unsigned long long> tableKeys;
+	ScratchVector<unsigned int> tableHeads;
+	unsigned int tableMask = 0;
+};
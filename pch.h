@@ -11,6 +11,7 @@
 
 #pragma once
 
+#ifdef __cplusplus_winrt
 #include <agile.h>
 #include <concrt.h>
 #include <d2d1_2.h>
@@ -35,3 +36,16 @@
 #include <string>
 #include <iomanip>
 //---
+#else
+//Outside the app (see tests/CMakeLists.txt) only the portable geometry code is built,
+//which needs DirectXMath and the standard library.
+#include <DirectXMath.h>
+#include <DirectXPackedVector.h>
+#include <memory>
+#include <map>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include "time.h"
+#include <string>
+#endif
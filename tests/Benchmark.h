@@ -0,0 +1,26 @@
+#pragma once
+
+#include <chrono>
+
+//Best of repeats runs of f in milliseconds, with setup run untimed before each of them.
+//The minimum is the least disturbed by other work on the machine.
+template <class Setup, class F>
+double BestMilliseconds(unsigned int repeats, const Setup& setup, const F& f)
+{
+	double best = 0.0;
+	for (unsigned int run = 0; run < repeats; run++) {
+		setup();
+		std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+		f();
+		double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		if (run == 0 || elapsed < best)
+			best = elapsed;
+	}
+	return best;
+}
+
+template <class F>
+double BestMilliseconds(unsigned int repeats, const F& f)
+{
+	return BestMilliseconds(repeats, [] {}, f);
+}
@@ -0,0 +1,83 @@
+#include "TestMesh.h"
+#include "Benchmark.h"
+#include "MeshDecode.h"
+#include <cstring>
+
+using namespace DirectX;
+
+//Bytes read and written per millisecond, in GB/s.
+static double Bandwidth(size_t bytes, double milliseconds)
+{
+	return bytes / milliseconds / 1e6;
+}
+
+//Decodes packed buffers of a surface of 1M vertices and 6M indices with the bulk kernels
+//and with the per-element loads and push_backs they replaced, against memcpy of the same
+//bytes as the ceiling.
+int main()
+{
+	const unsigned int vertexCount = 1 << 20;
+	const unsigned int indexCount = 6 * vertexCount;
+	std::mt19937 random(11);
+	std::vector<PackedVector::XMSHORTN4> positions(vertexCount);
+	std::vector<PackedVector::XMBYTEN4> normals(vertexCount);
+	std::vector<unsigned short> indices(indexCount);
+	for (unsigned int v = 0; v < vertexCount; v++) {
+		positions[v].x = (short)random();
+		positions[v].y = (short)random();
+		positions[v].z = (short)random();
+		positions[v].w = 0;
+		normals[v].x = (signed char)random();
+		normals[v].y = (signed char)random();
+		normals[v].z = (signed char)random();
+		normals[v].w = 0;
+	}
+	for (unsigned int i = 0; i < indexCount; i++)
+		indices[i] = (unsigned short)random();
+	XMFLOAT3 scale(2.0f, 2.0f, 2.0f);
+
+	std::vector<XMFLOAT3> decoded(vertexCount);
+	std::vector<unsigned int> decodedIndices(indexCount);
+	std::vector<XMFLOAT3> grown;
+	std::vector<unsigned int> grownIndices;
+
+	auto report = [](const char* name, size_t bytes, double bulk, double perElement, double copy) {
+		std::printf("%-9s bulk %6.2f ms (%5.2f GB/s), per element %6.2f ms (%5.2f GB/s), %.1fx; memcpy %5.2f GB/s\n",
+			name, bulk, Bandwidth(bytes, bulk), perElement, Bandwidth(bytes, perElement), perElement / bulk, Bandwidth(bytes, copy));
+	};
+	std::vector<unsigned char> copySource(indexCount * sizeof(unsigned int)), copyTarget(copySource.size());
+	auto copy = [&](size_t bytes) {
+		return BestMilliseconds(10, [&] { std::memcpy(copyTarget.data(), copySource.data(), bytes / 2); });
+	};
+
+	double bulk = BestMilliseconds(10, [&] { DecodePositions(positions.data(), vertexCount, scale, decoded.data()); });
+	double perElement = BestMilliseconds(10, [&] { grown.clear(); grown.shrink_to_fit(); }, [&] {
+		for (unsigned int v = 0; v < vertexCount; v++) {
+			XMFLOAT3 position;
+			XMStoreFloat3(&position, XMVectorMultiply(PackedVector::XMLoadShortN4(&positions[v]), XMLoadFloat3(&scale)));
+			grown.push_back(position);
+		}
+	});
+	size_t bytes = vertexCount * (sizeof(PackedVector::XMSHORTN4) + sizeof(XMFLOAT3));
+	report("positions", bytes, bulk, perElement, copy(bytes));
+
+	bulk = BestMilliseconds(10, [&] { DecodeNormals(normals.data(), vertexCount, decoded.data()); });
+	perElement = BestMilliseconds(10, [&] { grown.clear(); grown.shrink_to_fit(); }, [&] {
+		for (unsigned int v = 0; v < vertexCount; v++) {
+			XMFLOAT3 normal;
+			XMStoreFloat3(&normal, PackedVector::XMLoadByteN4(&normals[v]));
+			grown.push_back(normal);
+		}
+	});
+	bytes = vertexCount * (sizeof(PackedVector::XMBYTEN4) + sizeof(XMFLOAT3));
+	report("normals", bytes, bulk, perElement, copy(bytes));
+
+	bulk = BestMilliseconds(10, [&] { DecodeIndices(indices.data(), indexCount, decodedIndices.data()); });
+	perElement = BestMilliseconds(10, [&] { grownIndices.clear(); grownIndices.shrink_to_fit(); }, [&] {
+		for (unsigned int i = 0; i < indexCount; i++)
+			grownIndices.push_back(indices[i]);
+	});
+	bytes = indexCount * (sizeof(unsigned short) + sizeof(unsigned int));
+	report("indices", bytes, bulk, perElement, copy(bytes));
+	return 0;
+}
@@ -0,0 +1,86 @@
+#include "TestMesh.h"
+#include "EdgeAdjacency.h"
+#include <map>
+
+//Whether vertex is the corner of triangle t off the edge from a to b: the corner whose two
+//neighbours are a and b. For a triangle with a collapsed corner that can be a or b.
+static bool IsOpposite(const std::vector<unsigned int>& indices, unsigned int t, unsigned int a, unsigned int b, unsigned int vertex)
+{
+	for (unsigned int c = 0; c < 3; c++) {
+		unsigned int next = indices[3 * t + (c + 1) % 3], previous = indices[3 * t + (c + 2) % 3];
+		if (indices[3 * t + c] == vertex && std::min(next, previous) == std::min(a, b) && std::max(next, previous) == std::max(a, b))
+			return true;
+	}
+	return false;
+}
+
+//Checks the records of a mesh with non-manifold fans against a map of the triangles on
+//every undirected edge, in triangle order, and the opposite corner of every side.
+int main()
+{
+	TestMesh mesh = MakeRoom(12);
+	//Two more copies of some triangles put three and four triangles on their edges.
+	for (unsigned int copy = 0; copy < 2; copy++) {
+		for (unsigned int triangle = copy; triangle < 3000; triangle += 5)
+			mesh.indices.insert(mesh.indices.end(), mesh.indices.begin() + 3 * triangle, mesh.indices.begin() + 3 * triangle + 3);
+	}
+	//And a degenerate one, whose collapsed edge is skipped.
+	unsigned int degenerate[3] = { 0, 0, 1 };
+	mesh.indices.insert(mesh.indices.end(), degenerate, degenerate + 3);
+	unsigned int triangleCount = mesh.TriangleCount();
+
+	std::map<std::pair<unsigned int, unsigned int>, std::vector<unsigned int>> expected;
+	for (unsigned int t = 0; t < triangleCount; t++) {
+		for (unsigned int i = 0; i < 3; i++) {
+			unsigned int a = mesh.indices[3 * t + i], b = mesh.indices[3 * t + (i + 1) % 3];
+			if (a != b)
+				expected[std::make_pair(std::min(a, b), std::max(a, b))].push_back(t);
+		}
+	}
+
+	EdgeAdjacency adjacency;
+	adjacency.Build(mesh.indices.data(), triangleCount);
+	const ScratchVector<EdgeAdjacency::Edge>& edges = adjacency.GetEdges();
+
+	//Each edge is one run of records: a boundary record, or the first triangle paired with
+	//every later one in order.
+	unsigned int boundaries = 0, manifolds = 0, fans = 0;
+	std::map<std::pair<unsigned int, unsigned int>, bool> seen;
+	for (unsigned int first = 0; first < edges.size();) {
+		std::pair<unsigned int, unsigned int> key(edges[first].vertices[0], edges[first].vertices[1]);
+		CHECK(!seen[key]);
+		seen[key] = true;
+		const std::vector<unsigned int>& triangles = expected[key];
+		unsigned int last = first + 1;
+		while (last < edges.size() && edges[last].vertices[0] == key.first && edges[last].vertices[1] == key.second)
+			last++;
+		for (unsigned int record = first; record < last; record++) {
+			const EdgeAdjacency::Edge& edge = edges[record];
+			for (unsigned int side = 0; side < 2; side++) {
+				if (side == 1 && edge.IsBoundary())
+					CHECK(edge.opposite[1] == EdgeAdjacency::NO_TRIANGLE);
+				else
+					CHECK(IsOpposite(mesh.indices, edge.triangles[side], key.first, key.second, edge.opposite[side]));
+			}
+		}
+		if (triangles.size() == 1) {
+			CHECK(last == first + 1 && edges[first].IsBoundary() && edges[first].triangles[0] == triangles[0]);
+			boundaries++;
+		} else {
+			CHECK(last - first == triangles.size() - 1);
+			for (unsigned int record = first; record < last && record - first + 1 < triangles.size(); record++) {
+				CHECK(edges[record].triangles[0] == triangles[0]);
+				CHECK(edges[record].triangles[1] == triangles[record - first + 1]);
+			}
+			fans += triangles.size() > 2;
+			manifolds += triangles.size() == 2;
+		}
+		first = last;
+	}
+	CHECK(seen.size() == expected.size());
+	CHECK(boundaries > 0 && manifolds > 0 && fans > 0);
+	std::printf("%u records, %u edges: %u boundary, %u manifold, %u fans\n", (unsigned int)edges.size(), (unsigned int)expected.size(),
+		boundaries, manifolds, fans);
+
+	return TestResult();
+}
@@ -0,0 +1,141 @@
+#include "TestMesh.h"
+#include "EdgeExtraction.h"
+#include "SpatialGrid.h"
+#include <cmath>
+
+using namespace DirectX;
+
+//Every neighbour index finds the same pairs on a surface whose shared vertices are both
+//indexed and equal in position, so each operator must draw the same edges through the
+//adjacency records as through the kd-tree and grid searches.
+template <class Operator>
+static void TestSpatialMatchesAdjacency(const char* name, const TestMesh& mesh)
+{
+	unsigned int triangleCount = mesh.TriangleCount();
+	MeshView view = mesh.View();
+	ScratchVector<Triangle> triangles = mesh.Triangles();
+	auto representative = [](unsigned int vertex) { return vertex; };
+	const float threshold = 0.03f;
+
+	EdgeAdjacency adjacency;
+	adjacency.Build(mesh.indices.data(), triangleCount);
+	EdgeChunk adjacent(nullptr);
+	ExtractAdjacentChunk<Operator>(adjacent, adjacency.GetEdges(), 0, (unsigned int)adjacency.GetEdges().size(),
+		triangles.data(), mesh.indices.data(), mesh.indices.data(), view, representative, threshold);
+	std::vector<std::pair<unsigned int, unsigned int>> expected = SortedSegments(adjacent.lines, mesh);
+
+	Kdtree tree;
+	Kdtree::NodeIndex root = tree.Create(triangles, 0, 100);
+	tree.InsertAll(root);
+	EdgeChunk treeChunk(nullptr);
+	ExtractSpatialChunk<Operator>(treeChunk, triangles.data(), 0, triangleCount,
+		[&](const Triangle& triangle, Kdtree::IndexSpan spans[3]) { return tree.SearchTri(triangle, root, spans); }, threshold);
+
+	SpatialGrid grid;
+	grid.Create(triangles);
+	grid.InsertAll();
+	EdgeChunk gridChunk(nullptr);
+	ExtractSpatialChunk<Operator>(gridChunk, triangles.data(), 0, triangleCount,
+		[&](const Triangle& triangle, Kdtree::IndexSpan spans[3]) { return grid.SearchTri(triangle, spans); }, threshold);
+
+	std::printf("%s: adjacency %u, kd-tree %u, grid %u lines\n", name,
+		(unsigned int)adjacent.lines.size() / 2, (unsigned int)treeChunk.lines.size() / 2, (unsigned int)gridChunk.lines.size() / 2);
+	CHECK(!expected.empty());
+	CHECK(treeChunk.weightBatch.Size() == adjacent.weightBatch.Size());
+	CHECK(SortedSegments(treeChunk.lines, mesh) == expected);
+	CHECK(SortedSegments(gridChunk.lines, mesh) == expected);
+}
+
+//An operator the loops were not written for: the angle between the face normals scaled
+//by the ratio of the smaller to the larger face area, from eight inputs per edge.
+struct DihedralAreaOperator
+{
+	static const unsigned int INPUTS = 8;
+
+	template <class EdgeView>
+	static void Add(EdgeWeightBatch& batch, const EdgeView& edge)
+	{
+		const Triangle& a = edge.GetTriangle(0);
+		const Triangle& b = edge.GetTriangle(1);
+		const float values[INPUTS] = { a.faceNormal.x, a.faceNormal.y, a.faceNormal.z, b.faceNormal.x, b.faceNormal.y, b.faceNormal.z, a.area, b.area };
+		batch.Add(values);
+	}
+
+	static XMVECTOR XM_CALLCONV Weigh(const XMVECTOR* inputs)
+	{
+		XMVECTOR angles = SODOperator::Weigh(inputs);
+		return XMVectorMultiply(angles, XMVectorDivide(XMVectorMin(inputs[6], inputs[7]), XMVectorMax(inputs[6], inputs[7])));
+	}
+
+	static XMVECTOR XM_CALLCONV Limit(float threshold, EdgeWeightBatch::Classification)
+	{
+		return XMVectorReplicate(threshold);
+	}
+
+	static XMVECTOR XM_CALLCONV Above(const XMVECTOR* inputs, FXMVECTOR limit, EdgeWeightBatch::Classification)
+	{
+		return XMVectorGreater(Weigh(inputs), limit);
+	}
+
+	static float WeighReference(const float* inputs)
+	{
+		return SODOperator::WeighReference(inputs) * std::min(inputs[6], inputs[7]) / std::max(inputs[6], inputs[7]);
+	}
+};
+
+//The adjacency loop runs the operator unchanged and draws exactly the edges whose
+//reference weight is above the threshold, leaving out those too close to it to call.
+static void TestDeclaredInputs(const TestMesh& mesh)
+{
+	unsigned int triangleCount = mesh.TriangleCount();
+	MeshView view = mesh.View();
+	ScratchVector<Triangle> triangles = mesh.Triangles();
+	auto representative = [](unsigned int vertex) { return vertex; };
+	const float threshold = 0.02f;
+
+	EdgeAdjacency adjacency;
+	adjacency.Build(mesh.indices.data(), triangleCount);
+	const ScratchVector<EdgeAdjacency::Edge>& edges = adjacency.GetEdges();
+	EdgeChunk chunk(nullptr);
+	ExtractAdjacentChunk<DihedralAreaOperator>(chunk, edges, 0, (unsigned int)edges.size(),
+		triangles.data(), mesh.indices.data(), mesh.indices.data(), view, representative, threshold);
+	CHECK(chunk.weightBatch.InputCount() == DihedralAreaOperator::INPUTS);
+
+	std::vector<float> weights(chunk.weightBatch.Size()), reference(chunk.weightBatch.Size());
+	chunk.weightBatch.Compute<DihedralAreaOperator>(weights.data());
+	chunk.weightBatch.ComputeReference<DihedralAreaOperator>(reference.data());
+	ScratchVector<XMFLOAT3> expectedLines, uncertainLines;
+	for (unsigned int candidate = 0; candidate < weights.size(); candidate++) {
+		CHECK(std::fabs(weights[candidate] - reference[candidate]) <= 1e-5f);
+		const EdgeAdjacency::Edge& edge = edges[chunk.candidateRecords[candidate]];
+		ScratchVector<XMFLOAT3>* lines = nullptr;
+		if (std::fabs(reference[candidate] - threshold) <= 1e-5f)
+			lines = &uncertainLines;
+		else if (reference[candidate] > threshold)
+			lines = &expectedLines;
+		if (lines) {
+			lines->push_back(mesh.positions[edge.vertices[0]]);
+			lines->push_back(mesh.positions[edge.vertices[1]]);
+		}
+	}
+	auto drawn = [&](const ScratchVector<XMFLOAT3>& lines) {
+		std::vector<std::pair<unsigned int, unsigned int>> segments = SortedSegments(lines, mesh), uncertain = SortedSegments(uncertainLines, mesh);
+		segments.erase(std::unique(segments.begin(), segments.end()), segments.end());
+		segments.erase(std::remove_if(segments.begin(), segments.end(), [&](const std::pair<unsigned int, unsigned int>& segment) {
+			return std::binary_search(uncertain.begin(), uncertain.end(), segment);
+		}), segments.end());
+		return segments;
+	};
+	std::printf("dihedral with area: %u lines\n", (unsigned int)chunk.lines.size() / 2);
+	CHECK(!expectedLines.empty());
+	CHECK(drawn(chunk.lines) == drawn(expectedLines));
+}
+
+int main()
+{
+	TestMesh room = MakeRoom(12);
+	TestSpatialMatchesAdjacency<SODOperator>("SOD", room);
+	TestSpatialMatchesAdjacency<ESODOperator>("ESOD", room);
+	TestDeclaredInputs(room);
+	return TestResult();
+}
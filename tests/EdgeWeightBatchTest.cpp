@@ -0,0 +1,189 @@
+#include "TestMesh.h"
+#include "EdgeOperators.h"
+
+using namespace DirectX;
+
+static const float SENTINEL = -7.0f;
+
+//Random pairs: unit normals, or normals of any length with some zero ones, as the ESOD
+//operator passes vertex normals that may not be normalised.
+static void Fill(EdgeWeightBatch& batch, unsigned int count, bool unit, std::mt19937& random)
+{
+	std::uniform_real_distribution<float> axis(-1.0f, 1.0f);
+	std::uniform_real_distribution<float> length(0.01f, 10.0f);
+	auto normal = [&]() {
+		XMFLOAT3 n(axis(random), axis(random), axis(random));
+		float scale = unit ? 1.0f : length(random);
+		XMStoreFloat3(&n, XMVectorScale(XMVector3Normalize(XMLoadFloat3(&n)), scale));
+		if (!unit && random() % 7 == 0)
+			n = XMFLOAT3(0.0f, 0.0f, 0.0f);
+		return n;
+	};
+	batch.SetInputCount(6);
+	for (unsigned int i = 0; i < count; i++) {
+		XMFLOAT3 a = normal();
+		//Every fifth pair is nearly parallel, where acos is steepest.
+		XMFLOAT3 b = i % 5 == 0 ? XMFLOAT3(a.x + 1e-3f, a.y, a.z) : normal();
+		if (unit && i % 5 == 0)
+			XMStoreFloat3(&b, XMVector3Normalize(XMLoadFloat3(&b)));
+		batch.Add(a, b);
+	}
+}
+
+//The batched steps of an operator over the pairs: SOD without and ESOD with normalisation.
+static void Compute(const EdgeWeightBatch& batch, bool normalise, float* weights)
+{
+	if (normalise)
+		batch.Compute<ESODOperator>(weights);
+	else
+		batch.Compute<SODOperator>(weights);
+}
+
+static void ComputeReference(const EdgeWeightBatch& batch, bool normalise, float* weights)
+{
+	if (normalise)
+		batch.ComputeReference<ESODOperator>(weights);
+	else
+		batch.ComputeReference<SODOperator>(weights);
+}
+
+static void Classify(const EdgeWeightBatch& batch, bool normalise, float threshold, unsigned char* aboveThreshold)
+{
+	if (normalise)
+		batch.Classify<ESODOperator>(threshold, aboveThreshold);
+	else
+		batch.Classify<SODOperator>(threshold, aboveThreshold);
+}
+
+//Compute agrees with ComputeReference within the bounds of EdgeOperators.h for every
+//count up to a few steps, so every number of remainder lanes is covered, and writes
+//nothing past the last pair.
+static void TestCompute()
+{
+	std::mt19937 random(3);
+	EdgeWeightBatch batch;
+	for (unsigned int count = 0; count <= 19; count++) {
+		for (int unit = 0; unit < 2; unit++) {
+			for (int normalise = 0; normalise < 2; normalise++) {
+				if (!unit && !normalise)
+					continue;
+				Fill(batch, count, unit != 0, random);
+				std::vector<float> weights(count + 4, SENTINEL), reference(count, SENTINEL);
+				Compute(batch, normalise != 0, weights.data());
+				ComputeReference(batch, normalise != 0, reference.data());
+				for (unsigned int i = 0; i < count; i++) {
+					float difference = std::fabs(weights[i] - reference[i]);
+					float bound = normalise ? 1e-3f : 1e-6f;
+					//Away from parallel normals the rounding of the dot product barely moves acos.
+					if (reference[i] > 0.1f && reference[i] < XM_PI - 0.1f)
+						bound = 1e-5f;
+					CHECK(difference <= bound);
+				}
+				for (unsigned int i = count; i < count + 4; i++)
+					CHECK(weights[i] == SENTINEL);
+			}
+		}
+	}
+}
+
+//Both classifications match the reference angles against the threshold, apart from angles
+//within the acos error of it, and write nothing past the last pair.
+static void TestClassify()
+{
+	std::mt19937 random(5);
+	EdgeWeightBatch batch;
+	const float thresholds[] = { 0.0f, 0.05f, 0.4f, 1.5f, 3.0f };
+	const EdgeWeightBatch::Classification modes[] = { EdgeWeightBatch::COSINE, EdgeWeightBatch::ANGLE };
+	for (unsigned int count = 1; count <= 19; count++) {
+		for (int normalise = 0; normalise < 2; normalise++) {
+			Fill(batch, count * 7, normalise == 0, random);
+			std::vector<float> reference(batch.Size());
+			ComputeReference(batch, normalise != 0, reference.data());
+			for (EdgeWeightBatch::Classification mode : modes) {
+				batch.SetClassification(mode);
+				for (float threshold : thresholds) {
+					std::vector<unsigned char> above(batch.Size() + 4, 2);
+					Classify(batch, normalise != 0, threshold, above.data());
+					for (unsigned int i = 0; i < batch.Size(); i++) {
+						if (std::fabs(reference[i] - threshold) > 1e-3f)
+							CHECK(above[i] == (reference[i] > threshold));
+					}
+					for (unsigned int i = batch.Size(); i < batch.Size() + 4; i++)
+						CHECK(above[i] == 2);
+				}
+			}
+		}
+	}
+}
+
+//Thresholds outside [0, pi] have no cosine; both modes put every pair above a negative
+//threshold and none above one past pi.
+static void TestThresholdRange()
+{
+	std::mt19937 random(9);
+	EdgeWeightBatch batch;
+	Fill(batch, 11, true, random);
+	const EdgeWeightBatch::Classification modes[] = { EdgeWeightBatch::COSINE, EdgeWeightBatch::ANGLE };
+	for (EdgeWeightBatch::Classification mode : modes) {
+		batch.SetClassification(mode);
+		unsigned char above[11];
+		Classify(batch, false, -0.5f, above);
+		for (unsigned char value : above)
+			CHECK(value == 1);
+		Classify(batch, false, 4.0f, above);
+		for (unsigned char value : above)
+			CHECK(value == 0);
+	}
+}
+
+//The acos bound documented in EdgeOperators.h, against double std::acos. a = (1, 0, 0)
+//and b = (x, sqrt(1 - x^2), 0) have a dot product of exactly x, so Weigh gives acos(x)
+//as the batch computes it. The sweep covers [-1, 1] evenly and every float within 2^16
+//steps of -1, 0 and 1, where the polynomial and the square root are least accurate.
+static void TestAcosBound()
+{
+	std::vector<float> cosines;
+	for (int i = -(1 << 20); i <= (1 << 20); i++)
+		cosines.push_back(i / (float)(1 << 20));
+	const float ends[] = { -1.0f, 0.0f, 1.0f };
+	for (float end : ends) {
+		float below = end, above = end;
+		for (int step = 0; step < (1 << 16); step++) {
+			below = std::nextafter(below, -2.0f);
+			above = std::nextafter(above, 2.0f);
+			if (below >= -1.0f)
+				cosines.push_back(below);
+			if (above <= 1.0f)
+				cosines.push_back(above);
+		}
+	}
+
+	EdgeWeightBatch batch;
+	batch.SetInputCount(6);
+	std::vector<float> weights;
+	double worst = 0.0;
+	const unsigned int batchSize = 4096;
+	for (size_t first = 0; first < cosines.size(); first += batchSize) {
+		size_t last = std::min(first + batchSize, cosines.size());
+		batch.Clear();
+		for (size_t i = first; i < last; i++) {
+			float x = cosines[i];
+			batch.Add(XMFLOAT3(1.0f, 0.0f, 0.0f), XMFLOAT3(x, std::sqrt(std::max(0.0f, 1.0f - x * x)), 0.0f));
+		}
+		weights.resize(batch.Size());
+		batch.Compute<SODOperator>(weights.data());
+		for (size_t i = first; i < last; i++)
+			worst = std::max(worst, std::fabs(weights[i - first] - std::acos((double)cosines[i])));
+	}
+	std::printf("acos: largest error %.3g rad over %u cosines\n", worst, (unsigned int)cosines.size());
+	CHECK(worst <= 5e-7);
+}
+
+int main()
+{
+	TestCompute();
+	TestClassify();
+	TestThresholdRange();
+	TestAcosBound();
+	return TestResult();
+}
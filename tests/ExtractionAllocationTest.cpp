@@ -0,0 +1,242 @@
+#include "TestMesh.h"
+#include "EdgeExtraction.h"
+#include "MeshDecode.h"
+#include "QuantizedWeld.h"
+#include "SpatialGrid.h"
+#include "VertexWeld.h"
+#include <cmath>
+#include <cstdlib>
+#include <new>
+
+//Processing a surface must not touch the heap once its arena has grown to fit it. Every
+//operator new is counted while countAllocations is set, and the whole pipeline of
+//HolographicSpatialMappingMain::ProcessMesh runs over the same surface several times with
+//the arena reset in between, as ScratchArenaPool does for consecutive surfaces: decoding,
+//welding, building the neighbour index, the chunk loops and joining their lines. The
+//chunks run one after the other, since only the storage is under test.
+
+static bool countAllocations = false;
+static unsigned int allocationCount = 0;
+
+void* operator new(size_t size)
+{
+	if (countAllocations)
+		allocationCount++;
+	void* memory = std::malloc(size ? size : 1);
+	if (!memory)
+		throw std::bad_alloc();
+	return memory;
+}
+
+void operator delete(void* memory) noexcept { std::free(memory); }
+void operator delete(void* memory, size_t) noexcept { std::free(memory); }
+
+static const unsigned int chunkSize = 1024;
+
+enum NeighbourIndex { EDGE_ADJACENCY, HALF_EDGE, KDTREE, HASH_GRID };
+
+//A surface in the buffer formats of the device: SNORM16 positions under a scale, SNORM8
+//normals and 16-bit indices.
+struct DeviceSurface
+{
+	std::vector<DirectX::PackedVector::XMSHORTN4> positions;
+	std::vector<DirectX::PackedVector::XMBYTEN4> normals;
+	std::vector<unsigned short> indices;
+	DirectX::XMFLOAT3 scale;
+
+	MeshView View() const
+	{
+		MeshView view;
+		view.SetPositions(positions.data(), (unsigned int)positions.size(), sizeof(DirectX::PackedVector::XMSHORTN4), MeshView::POSITION_SNORM16, scale);
+		view.SetNormals(normals.data(), (unsigned int)normals.size(), sizeof(DirectX::PackedVector::XMBYTEN4), MeshView::NORMAL_SNORM8);
+		view.SetIndices(indices.data(), (unsigned int)indices.size(), MeshView::INDEX_UINT16);
+		return view;
+	}
+};
+
+static DeviceSurface Pack(const TestMesh& mesh, float scale)
+{
+	DeviceSurface surface;
+	surface.scale = DirectX::XMFLOAT3(scale, scale, scale);
+	surface.positions.resize(mesh.positions.size());
+	for (size_t v = 0; v < mesh.positions.size(); v++) {
+		const DirectX::XMFLOAT3& p = mesh.positions[v];
+		surface.positions[v].x = (short)std::lround(p.x / scale * 32767);
+		surface.positions[v].y = (short)std::lround(p.y / scale * 32767);
+		surface.positions[v].z = (short)std::lround(p.z / scale * 32767);
+		surface.positions[v].w = 0;
+	}
+	surface.normals.resize(mesh.normals.size());
+	for (size_t v = 0; v < mesh.normals.size(); v++) {
+		const DirectX::XMFLOAT3& n = mesh.normals[v];
+		surface.normals[v].x = (signed char)std::lround(n.x * 127);
+		surface.normals[v].y = (signed char)std::lround(n.y * 127);
+		surface.normals[v].z = (signed char)std::lround(n.z * 127);
+		surface.normals[v].w = 0;
+	}
+	surface.indices.assign(mesh.indices.begin(), mesh.indices.end());
+	return surface;
+}
+
+//Splits [0, count) into chunks of chunkSize, moving a start forward while split(start)
+//says it falls inside a group that must stay in one chunk.
+template <class Split>
+void ChunkStarts(ScratchVector<unsigned int>& starts, unsigned int count, const Split& split)
+{
+	for (unsigned int first = 0; first < count; first += chunkSize) {
+		while (first > 0 && first < count && split(first))
+			first++;
+		starts.push_back(first);
+	}
+	starts.push_back(count);
+}
+
+//Everything ProcessMesh does for one surface up to the joined lines, with all storage
+//taken from arena. weldEpsilon selects the decoded weld on the adjacency paths.
+template <class Operator>
+ScratchVector<DirectX::XMFLOAT3> ProcessSurface(ScratchArena* arena, const DeviceSurface& surface, NeighbourIndex neighbourIndex, float weldEpsilon)
+{
+	const float threshold = 0.03f;
+	MeshView view = surface.View();
+	unsigned int vertexCount = view.VertexCount();
+	unsigned int triangleCount = view.TriangleCount();
+
+	ScratchVector<unsigned int> indexData(arena);
+	ScratchVector<DirectX::XMFLOAT3> vertexData(arena);
+	ScratchVector<DirectX::XMFLOAT3> vertexNormalsData(arena);
+	vertexData.resize(vertexCount);
+	vertexNormalsData.resize(view.NormalCount());
+	indexData.resize(view.IndexCount());
+	DecodePositions(view.PackedPositions(), vertexCount, surface.scale, vertexData.data());
+	DecodeNormals(view.PackedNormals(), view.NormalCount(), vertexNormalsData.data());
+	DecodeIndices(view.GetIndices<unsigned short>(), view.IndexCount(), indexData.data());
+
+	ScratchVector<Triangle> triangles(arena);
+	triangles.reserve(triangleCount);
+	for (unsigned int corner = 0; corner < indexData.size(); corner += 3) {
+		unsigned int a = indexData[corner], b = indexData[corner + 1], c = indexData[corner + 2];
+		triangles.push_back(Triangle(vertexData[a], vertexData[b], vertexData[c], vertexNormalsData[a], vertexNormalsData[b], vertexNormalsData[c]));
+	}
+
+	Kdtree tree(arena);
+	SpatialGrid grid(arena);
+	EdgeAdjacency adjacency(arena);
+	HalfEdgeMesh halfEdges(arena);
+	QuantizedWeld weld(arena);
+	VertexWeld tolerantWeld(arena);
+	ScratchVector<unsigned int> weldedIndices(arena);
+	ScratchVector<unsigned int> chunkStarts(arena);
+	Kdtree::NodeIndex root = Kdtree::ROOT;
+	bool decodedWeld = weldEpsilon > 0.0f;
+	if (neighbourIndex == EDGE_ADJACENCY || neighbourIndex == HALF_EDGE) {
+		weldedIndices.resize(3 * triangleCount);
+		unsigned int mergedVertices;
+		if (decodedWeld) {
+			tolerantWeld.Build(vertexData.data(), vertexCount, weldEpsilon);
+			for (unsigned int corner = 0; corner < 3 * triangleCount; corner++)
+				weldedIndices[corner] = tolerantWeld.Welded(indexData[corner]);
+			mergedVertices = tolerantWeld.MergedCount();
+		} else {
+			weld.Build(view.PackedPositions(), vertexCount);
+			for (unsigned int corner = 0; corner < 3 * triangleCount; corner++)
+				weldedIndices[corner] = weld.Welded(indexData[corner]);
+			mergedVertices = weld.MergedCount();
+		}
+		if (neighbourIndex == HALF_EDGE) {
+			halfEdges.Build(weldedIndices.data(), triangleCount, vertexCount - mergedVertices);
+			ChunkStarts(chunkStarts, halfEdges.HalfEdgeCount(), [](unsigned int) { return false; });
+		} else {
+			adjacency.Build(weldedIndices.data(), triangleCount);
+			const ScratchVector<EdgeAdjacency::Edge>& edges = adjacency.GetEdges();
+			ChunkStarts(chunkStarts, (unsigned int)edges.size(), [&](unsigned int first) { return SameEdge(edges[first - 1], edges[first]); });
+		}
+	} else {
+		if (neighbourIndex == KDTREE) {
+			//The build runs on one thread here, as the chunks do: starting the threads of
+			//the compat parallel_invoke allocates their state, which is not the tree's.
+			tree.SetParallelBuild(0, 0);
+			root = tree.Create(triangles, 0, 100);
+			tree.InsertAll(root);
+		} else {
+			grid.Create(triangles);
+			grid.InsertAll();
+		}
+		ChunkStarts(chunkStarts, triangleCount, [](unsigned int) { return false; });
+	}
+
+	auto representative = [&](unsigned int weldedVertex) {
+		return decodedWeld ? tolerantWeld.Representative(weldedVertex) : weld.Representative(weldedVertex);
+	};
+	auto search = [&](const Triangle& triangle, Kdtree::IndexSpan spans[3]) {
+		return neighbourIndex == KDTREE ? tree.SearchTri(triangle, root, spans) : grid.SearchTri(triangle, spans);
+	};
+	unsigned int chunkCount = (unsigned int)chunkStarts.size() - 1;
+	ScratchVector<EdgeChunk> chunks(arena);
+	chunks.reserve(chunkCount);
+	for (unsigned int chunk = 0; chunk < chunkCount; chunk++) {
+		chunks.emplace_back(arena);
+		EdgeChunk& current = chunks[chunk];
+		current.weightBatch.SetClassification(EdgeWeightBatch::COSINE);
+		unsigned int first = chunkStarts[chunk], last = chunkStarts[chunk + 1];
+		if (neighbourIndex == EDGE_ADJACENCY)
+			ExtractAdjacentChunk<Operator>(current, adjacency.GetEdges(), first, last, triangles.data(), weldedIndices.data(), view.GetIndices<unsigned short>(), view, representative, threshold);
+		else if (neighbourIndex == HALF_EDGE)
+			ExtractHalfEdgeChunk<Operator>(current, halfEdges, first, last, triangles.data(), view.GetIndices<unsigned short>(), view, representative, threshold);
+		else
+			ExtractSpatialChunk<Operator>(current, triangles.data(), first, last, search, threshold);
+	}
+
+	size_t lineVertexCount = 0;
+	for (const EdgeChunk& chunk : chunks)
+		lineVertexCount += chunk.lines.size();
+	ScratchVector<DirectX::XMFLOAT3> lines(arena);
+	lines.reserve(lineVertexCount);
+	for (const EdgeChunk& chunk : chunks)
+		lines.insert(lines.end(), chunk.lines.begin(), chunk.lines.end());
+	return lines;
+}
+
+//The first run grows the arena and the Reset after it merges the blocks; the runs after
+//that must not allocate and must give the lines of a heap run.
+template <class Operator>
+void CheckSteadyState(const char* name, const DeviceSurface& surface, NeighbourIndex neighbourIndex, float weldEpsilon = 0.0f)
+{
+	ScratchVector<DirectX::XMFLOAT3> expected = ProcessSurface<Operator>(nullptr, surface, neighbourIndex, weldEpsilon);
+	ScratchArena arena;
+	for (unsigned int run = 0; run < 3; run++) {
+		arena.Reset();
+		allocationCount = 0;
+		countAllocations = true;
+		{
+			ScratchVector<DirectX::XMFLOAT3> lines = ProcessSurface<Operator>(&arena, surface, neighbourIndex, weldEpsilon);
+			countAllocations = false;
+			std::printf("%s run %u: %u lines, %u heap allocations, %u arena allocations\n",
+				name, run, (unsigned int)lines.size() / 2, allocationCount, arena.GetCounters().allocations);
+			CHECK(lines.size() == expected.size());
+			CHECK(std::equal(lines.begin(), lines.end(), expected.begin(), expected.end(),
+				[](const DirectX::XMFLOAT3& a, const DirectX::XMFLOAT3& b) { return a == b; }));
+		}
+		if (run > 0)
+			CHECK(allocationCount == 0);
+	}
+	CHECK(!expected.empty());
+}
+
+int main()
+{
+	TestMesh mesh = MakeRoom(12);
+	//Copies of a few triangles make non-manifold fans on their edges.
+	for (unsigned int triangle = 0; triangle < 300; triangle += 7)
+		mesh.indices.insert(mesh.indices.end(), mesh.indices.begin() + 3 * triangle, mesh.indices.begin() + 3 * triangle + 3);
+	DeviceSurface surface = Pack(mesh, 6.0f);
+
+	CheckSteadyState<SODOperator>("adjacency SOD", surface, EDGE_ADJACENCY);
+	CheckSteadyState<ESODOperator>("adjacency ESOD", surface, EDGE_ADJACENCY);
+	CheckSteadyState<ESODOperator>("adjacency ESOD, tolerant weld", surface, EDGE_ADJACENCY, 0.001f);
+	CheckSteadyState<ESODOperator>("half-edge ESOD", surface, HALF_EDGE);
+	CheckSteadyState<SODOperator>("half-edge SOD, tolerant weld", surface, HALF_EDGE, 0.001f);
+	CheckSteadyState<ESODOperator>("kd-tree ESOD", surface, KDTREE);
+	CheckSteadyState<SODOperator>("grid SOD", surface, HASH_GRID);
+
+	return TestResult();
+}
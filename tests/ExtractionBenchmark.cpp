@@ -0,0 +1,89 @@
+#include "TestMesh.h"
+#include "Benchmark.h"
+#include "EdgeExtraction.h"
+#include "SpatialGrid.h"
+#include <ppl.h>
+#include <thread>
+
+static const unsigned int chunkSize = 4096;
+
+//Runs the chunks [0, chunkCount) serially or with parallel_for, as PopulateEdgeList does,
+//and joins their lines in chunk order.
+template <class Extract>
+std::vector<DirectX::XMFLOAT3> ExtractAll(unsigned int chunkCount, bool parallel, const Extract& extract)
+{
+	std::vector<EdgeChunk> chunks(chunkCount, EdgeChunk(nullptr));
+	auto run = [&](unsigned int chunk) {
+		chunks[chunk].weightBatch.SetClassification(EdgeWeightBatch::COSINE);
+		extract(chunks[chunk], chunk);
+	};
+	if (parallel) {
+		concurrency::parallel_for(0u, chunkCount, run);
+	} else {
+		for (unsigned int chunk = 0; chunk < chunkCount; chunk++)
+			run(chunk);
+	}
+	std::vector<DirectX::XMFLOAT3> lines;
+	for (const EdgeChunk& chunk : chunks)
+		lines.insert(lines.end(), chunk.lines.begin(), chunk.lines.end());
+	return lines;
+}
+
+//One chunk for the whole surface, the chunks one after another, and the chunks on the
+//thread pool; the lines must be the same every time.
+template <class Extract>
+void Run(const char* name, unsigned int itemCount, const ScratchVector<unsigned int>& chunkStarts, const Extract& extract)
+{
+	unsigned int chunkCount = (unsigned int)chunkStarts.size() - 1;
+	std::vector<DirectX::XMFLOAT3> whole, serial, parallel;
+	double wholeTime = BestMilliseconds(5, [&] {
+		whole = ExtractAll(1, false, [&](EdgeChunk& chunk, unsigned int) { extract(chunk, 0, itemCount); });
+	});
+	auto chunked = [&](EdgeChunk& chunk, unsigned int index) { extract(chunk, chunkStarts[index], chunkStarts[index + 1]); };
+	double serialTime = BestMilliseconds(5, [&] { serial = ExtractAll(chunkCount, false, chunked); });
+	double parallelTime = BestMilliseconds(5, [&] { parallel = ExtractAll(chunkCount, true, chunked); });
+	auto same = [](const std::vector<DirectX::XMFLOAT3>& a, const std::vector<DirectX::XMFLOAT3>& b) {
+		return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const DirectX::XMFLOAT3& x, const DirectX::XMFLOAT3& y) { return x == y; });
+	};
+	std::printf("%s: one chunk %.2f ms, %u chunks serial %.2f ms, parallel %.2f ms (%.2fx), %u lines, %s\n",
+		name, wholeTime, chunkCount, serialTime, parallelTime, wholeTime / parallelTime, (unsigned int)whole.size() / 2,
+		same(whole, serial) && same(whole, parallel) ? "identical" : "DIFFERENT");
+}
+
+int main()
+{
+	TestMesh mesh = MakeRoom(39);
+	unsigned int triangleCount = mesh.TriangleCount();
+	MeshView view = mesh.View();
+	ScratchVector<Triangle> triangles = mesh.Triangles();
+	auto representative = [](unsigned int vertex) { return vertex; };
+	const float threshold = 0.03f;
+	std::printf("%u triangles, %u hardware threads\n", triangleCount, std::thread::hardware_concurrency());
+
+	EdgeAdjacency adjacency;
+	adjacency.Build(mesh.indices.data(), triangleCount);
+	const ScratchVector<EdgeAdjacency::Edge>& edges = adjacency.GetEdges();
+	ScratchVector<unsigned int> recordStarts;
+	for (unsigned int first = 0; first < edges.size(); first += chunkSize) {
+		while (first > 0 && first < edges.size() && SameEdge(edges[first - 1], edges[first]))
+			first++;
+		recordStarts.push_back(first);
+	}
+	recordStarts.push_back((unsigned int)edges.size());
+	Run("adjacency ESOD", (unsigned int)edges.size(), recordStarts, [&](EdgeChunk& chunk, unsigned int first, unsigned int last) {
+		ExtractAdjacentChunk<ESODOperator>(chunk, edges, first, last, triangles.data(), mesh.indices.data(), mesh.indices.data(), view, representative, threshold);
+	});
+
+	ScratchVector<unsigned int> triangleStarts;
+	for (unsigned int first = 0; first < triangleCount; first += chunkSize)
+		triangleStarts.push_back(first);
+	triangleStarts.push_back(triangleCount);
+	SpatialGrid grid;
+	grid.Create(triangles);
+	grid.InsertAll();
+	auto gridSearch = [&](const Triangle& triangle, Kdtree::IndexSpan spans[3]) { return grid.SearchTri(triangle, spans); };
+	Run("grid ESOD", triangleCount, triangleStarts, [&](EdgeChunk& chunk, unsigned int first, unsigned int last) {
+		ExtractSpatialChunk<ESODOperator>(chunk, triangles.data(), first, last, gridSearch, threshold);
+	});
+	return 0;
+}
@@ -0,0 +1,83 @@
+#include "TestMesh.h"
+#include "HalfEdgeMesh.h"
+#include "EdgeExtraction.h"
+
+//Counts how often ForEachOneRing reports each neighbour of a vertex.
+static std::map<unsigned int, unsigned int> OneRing(const HalfEdgeMesh& mesh, unsigned int vertex)
+{
+	std::map<unsigned int, unsigned int> reported;
+	mesh.ForEachOneRing(vertex, [&](unsigned int neighbour) { reported[neighbour]++; });
+	return reported;
+}
+
+//Two triangles on the edge 0-1, wound consistently and then inconsistently. Only the
+//consistent pair are twins; across the other edge the neighbour is reported per face.
+static void TestWinding()
+{
+	unsigned int consistent[6] = { 0, 1, 2, 1, 0, 3 };
+	HalfEdgeMesh mesh;
+	mesh.Build(consistent, 2, 4);
+	CHECK(mesh.Twin(0) == 3 && mesh.Twin(3) == 0);
+	CHECK(mesh.BoundaryHalfEdgeCount() == 4);
+	std::map<unsigned int, unsigned int> ring = OneRing(mesh, 0);
+	CHECK(ring.size() == 3 && ring[1] == 1 && ring[2] == 1 && ring[3] == 1);
+
+	unsigned int inconsistent[6] = { 0, 1, 2, 0, 1, 3 };
+	mesh.Build(inconsistent, 2, 4);
+	CHECK(mesh.IsBoundary(0) && mesh.IsBoundary(3));
+	CHECK(mesh.NonManifoldEdgeCount() == 1);
+	ring = OneRing(mesh, 0);
+	CHECK(ring.size() == 3 && ring[1] == 2 && ring[2] == 1 && ring[3] == 1);
+	ring = OneRing(mesh, 1);
+	CHECK(ring.size() == 3 && ring[0] == 2 && ring[2] == 1 && ring[3] == 1);
+}
+
+//All storage of a mesh built with an arena comes from it.
+static void TestArena()
+{
+	TestMesh grid = MakeGrid(30);
+	ScratchArena arena;
+	HalfEdgeMesh mesh(&arena);
+	mesh.Build(grid.indices.data(), grid.TriangleCount(), (unsigned int)grid.positions.size());
+	CHECK(arena.GetCounters().allocations >= 5);
+	CHECK(mesh.BoundaryHalfEdgeCount() == 4 * 30);
+	CHECK(mesh.NonManifoldEdgeCount() == 0);
+}
+
+//On a manifold, consistently wound surface the half-edge extraction draws exactly the
+//edges of the adjacency extraction, for both operators.
+template <class Operator>
+static void TestMatchesAdjacency(const TestMesh& mesh)
+{
+	unsigned int triangleCount = mesh.TriangleCount();
+	MeshView view = mesh.View();
+	ScratchVector<Triangle> triangles = mesh.Triangles();
+	auto representative = [](unsigned int vertex) { return vertex; };
+	const float threshold = 0.03f;
+
+	EdgeAdjacency adjacency;
+	adjacency.Build(mesh.indices.data(), triangleCount);
+	EdgeChunk adjacent(nullptr);
+	ExtractAdjacentChunk<Operator>(adjacent, adjacency.GetEdges(), 0, (unsigned int)adjacency.GetEdges().size(),
+		triangles.data(), mesh.indices.data(), mesh.indices.data(), view, representative, threshold);
+
+	HalfEdgeMesh halfEdges;
+	halfEdges.Build(mesh.indices.data(), triangleCount, (unsigned int)mesh.positions.size());
+	CHECK(halfEdges.NonManifoldEdgeCount() == 0);
+	EdgeChunk twins(nullptr);
+	ExtractHalfEdgeChunk<Operator>(twins, halfEdges, 0, halfEdges.HalfEdgeCount(), triangles.data(), mesh.indices.data(), view, representative, threshold);
+
+	CHECK(twins.weightBatch.Size() == adjacent.weightBatch.Size());
+	CHECK(!adjacent.lines.empty());
+	CHECK(SortedSegments(twins.lines, mesh) == SortedSegments(adjacent.lines, mesh));
+}
+
+int main()
+{
+	TestWinding();
+	TestArena();
+	TestMesh room = MakeRoom(12);
+	TestMatchesAdjacency<SODOperator>(room);
+	TestMatchesAdjacency<ESODOperator>(room);
+	return TestResult();
+}
@@ -0,0 +1,28 @@
+#include "TestMesh.h"
+#include "Benchmark.h"
+#include "Kdtree.h"
+
+//Times Create with the SORT_COPY and IN_PLACE builders on rooms of about 10k, 100k and
+//1M triangles. Leaves are not filled, so only the node construction is measured.
+static void Run(unsigned int density)
+{
+	TestMesh mesh = MakeRoom(density);
+	ScratchVector<Triangle> triangles = mesh.Triangles();
+	unsigned int repeats = triangles.size() > 500000 ? 3 : 5;
+
+	Kdtree tree;
+	double sortCopy = BestMilliseconds(repeats, [&] { tree.Create(triangles, 0, 100, Kdtree::SORT_COPY); });
+	unsigned int sortCopyNodes = tree.GetStats().nodeCount;
+	double inPlace = BestMilliseconds(repeats, [&] { tree.Create(triangles, 0, 100, Kdtree::IN_PLACE); });
+	unsigned int inPlaceNodes = tree.GetStats().nodeCount;
+	std::printf("%8u triangles: SORT_COPY %9.2f ms (%u nodes), IN_PLACE %8.2f ms (%u nodes), %.1fx\n",
+		(unsigned int)triangles.size(), sortCopy, sortCopyNodes, inPlace, inPlaceNodes, sortCopy / inPlace);
+}
+
+int main()
+{
+	Run(9);
+	Run(28);
+	Run(88);
+	return 0;
+}
@@ -0,0 +1,36 @@
+#include "TestMesh.h"
+#include "Benchmark.h"
+#include "Kdtree.h"
+#include <thread>
+
+//Whether the subtrees below two nodes are the same, split for split.
+static bool SameTree(const Kdtree& a, const Kdtree& b, Kdtree::NodeIndex node)
+{
+	const Kdtree::Node& nodeA = a.GetNode(node);
+	const Kdtree::Node& nodeB = b.GetNode(node);
+	if (nodeA.split != nodeB.split || nodeA.tag != nodeB.tag)
+		return false;
+	return nodeA.IsLeaf() || (SameTree(a, b, nodeA.LeftChild()) && SameTree(a, b, nodeA.RightChild()));
+}
+
+//Times an IN_PLACE build of a room of about 1M triangles with the subtrees forked down to
+//increasing depths, against the serial build, and checks every node array is identical.
+int main()
+{
+	TestMesh mesh = MakeRoom(88);
+	ScratchVector<Triangle> triangles = mesh.Triangles();
+	std::printf("%u triangles, %u hardware threads\n", (unsigned int)triangles.size(), std::thread::hardware_concurrency());
+
+	Kdtree serial;
+	double serialTime = BestMilliseconds(3, [&] { serial.Create(triangles, 0, 100); });
+	std::printf("serial: %.2f ms\n", serialTime);
+
+	for (int depth = 1; depth <= 4; depth++) {
+		Kdtree tree;
+		tree.SetParallelBuild(depth, 4096);
+		double time = BestMilliseconds(3, [&] { tree.Create(triangles, 0, 100); });
+		std::printf("parallel depth %d (up to %d tasks): %.2f ms, %.2fx, %s\n", depth, 1 << depth, time, serialTime / time,
+			SameTree(serial, tree, Kdtree::ROOT) ? "identical" : "DIFFERENT");
+	}
+	return 0;
+}
@@ -0,0 +1,412 @@
+#include "TestMesh.h"
+#include "Kdtree.h"
+#include <cmath>
+#include <thread>
+
+//Queries from concurrent chunks must add up to the counts of the same queries run serially.
+static void TestConcurrentQueryStats(const ScratchVector<Triangle>& triangles)
+{
+	Kdtree tree;
+	Kdtree::NodeIndex root = tree.Create(triangles, 0, 100);
+	tree.InsertAll(root);
+
+	auto searchAll = [&]() {
+		Kdtree::IndexSpan spans[3];
+		for (const Triangle& triangle : triangles)
+			tree.SearchTri(triangle, root, spans);
+	};
+	searchAll();
+	Kdtree::Stats serial = tree.GetStats();
+
+	const unsigned int threadCount = 4;
+	tree.ResetQueryStats();
+	std::vector<std::thread> threads;
+	for (unsigned int thread = 0; thread < threadCount; thread++)
+		threads.emplace_back(searchAll);
+	for (std::thread& thread : threads)
+		thread.join();
+	Kdtree::Stats concurrent = tree.GetStats();
+
+	CHECK(serial.queries == triangles.size());
+	CHECK(concurrent.queries == threadCount * serial.queries);
+	CHECK(concurrent.visitedNodes == threadCount * serial.visitedNodes);
+	CHECK(concurrent.candidates == threadCount * serial.candidates);
+
+	//MeasureQueryCost reports what SearchTri counts, and leaves the counters alone.
+	Kdtree::QueryCost cost = tree.MeasureQueryCost(triangles, root);
+	CHECK(tree.GetStats().queries == concurrent.queries);
+	CHECK(std::fabs(cost.visitedNodes * triangles.size() - serial.visitedNodes) < 0.5);
+	CHECK(std::fabs(cost.candidates * triangles.size() - serial.candidates) < 0.5);
+}
+
+//Every node must count exactly the entries stored below it after any mix of updates,
+//since the scapegoat rebuilds are triggered from those counts.
+static void TestUpdateCounts(const TestMesh& mesh)
+{
+	ScratchVector<Triangle> triangles = mesh.Triangles();
+	unsigned int half = (unsigned int)triangles.size() / 2;
+	ScratchVector<Triangle> source(triangles.begin(), triangles.begin() + half);
+	Kdtree tree;
+	Kdtree::NodeIndex root = tree.Create(source, 0, 100);
+	tree.InsertAll(root);
+	CHECK(tree.GetStats().countErrors == 0);
+
+	std::vector<unsigned int> added;
+	for (unsigned int triangle = half; triangle < triangles.size(); triangle++) {
+		source.push_back(triangles[triangle]);
+		added.push_back(triangle);
+	}
+	tree.Insert(added, root);
+	CHECK(tree.GetStats().countErrors == 0);
+
+	std::vector<unsigned int> removed;
+	for (unsigned int triangle = 0; triangle < source.size(); triangle += 3)
+		removed.push_back(triangle);
+	tree.Remove(removed, root);
+	CHECK(tree.GetStats().countErrors == 0);
+
+	for (unsigned int triangle : removed)
+		tree.Insert(triangle, root);
+	Kdtree::Stats stats = tree.GetStats();
+	CHECK(stats.countErrors == 0);
+
+	//Every triangle is found again from each of its vertices.
+	unsigned int missing = 0;
+	Kdtree::IndexSpan spans[3];
+	for (unsigned int triangle = 0; triangle < source.size(); triangle++) {
+		unsigned int spanCount = tree.SearchTri(source[triangle], root, spans);
+		for (unsigned int span = 0; span < spanCount; span++) {
+			if (std::find(spans[span].begin(), spans[span].end(), triangle) == spans[span].end())
+				missing++;
+		}
+	}
+	CHECK(missing == 0);
+}
+
+//Updating a tenth of the triangles must leave a tree of about the shape of a fresh build.
+//Rebuilds that split a flat axis, or put ties on the wrong side of the split, chain nodes
+//down to the depth limit instead.
+static void TestRebuildShape(const TestMesh& mesh)
+{
+	ScratchVector<Triangle> triangles = mesh.Triangles();
+	Kdtree fresh;
+	fresh.InsertAll(fresh.Create(triangles, 0, 100));
+	Kdtree::Stats freshStats = fresh.GetStats();
+
+	Kdtree tree;
+	Kdtree::NodeIndex root = tree.Create(triangles, 0, 100);
+	tree.InsertAll(root);
+	std::vector<unsigned int> updated;
+	for (unsigned int triangle = 0; triangle < triangles.size(); triangle += 10)
+		updated.push_back(triangle);
+	tree.Remove(updated, root);
+	tree.Insert(updated, root);
+	Kdtree::Stats stats = tree.GetStats();
+
+	std::printf("fresh depth %u, %u nodes; updated depth %u, %u nodes\n",
+		(unsigned int)freshStats.depthHistogram.size() - 1, freshStats.nodeCount, (unsigned int)stats.depthHistogram.size() - 1, stats.nodeCount);
+	CHECK(stats.countErrors == 0);
+	CHECK(stats.depthHistogram.size() <= 2 * freshStats.depthHistogram.size());
+	CHECK(2 * stats.nodeCount <= 3 * freshStats.nodeCount);
+}
+
+//Batches larger than half the tree rebuild it over the triangles it holds afterwards, so
+//the result has the shape of a fresh build over them, and everything is found again.
+static void TestRebuildFallback(const TestMesh& mesh)
+{
+	ScratchVector<Triangle> triangles = mesh.Triangles();
+	Kdtree tree;
+	Kdtree::NodeIndex root = tree.Create(triangles, 0, 100);
+	tree.InsertAll(root);
+	std::vector<unsigned int> removed;
+	ScratchVector<Triangle> kept;
+	for (unsigned int triangle = 0; triangle < triangles.size(); triangle++) {
+		if (triangle % 4 == 0)
+			kept.push_back(triangles[triangle]);
+		else
+			removed.push_back(triangle);
+	}
+	tree.Remove(removed, root);
+	Kdtree keptTree;
+	keptTree.InsertAll(keptTree.Create(kept, 0, 100));
+	Kdtree::Stats stats = tree.GetStats();
+	Kdtree::Stats keptStats = keptTree.GetStats();
+	CHECK(stats.countErrors == 0);
+	CHECK(stats.nodeCount == keptStats.nodeCount);
+	CHECK(stats.depthHistogram == keptStats.depthHistogram);
+	CHECK(stats.leafOccupancy == keptStats.leafOccupancy);
+
+	tree.Insert(removed, root);
+	Kdtree fresh;
+	fresh.InsertAll(fresh.Create(triangles, 0, 100));
+	stats = tree.GetStats();
+	CHECK(stats.countErrors == 0);
+	CHECK(stats.nodeCount == fresh.GetStats().nodeCount);
+	CHECK(stats.leafOccupancy == fresh.GetStats().leafOccupancy);
+
+	//Removing everything leaves the nodes in place for the next fill.
+	std::vector<unsigned int> all(triangles.size());
+	for (unsigned int triangle = 0; triangle < all.size(); triangle++)
+		all[triangle] = triangle;
+	tree.Remove(all, root);
+	CHECK(tree.GetStats().countErrors == 0);
+	CHECK(tree.GetStats().nodeCount == fresh.GetStats().nodeCount);
+	tree.Insert(all, root);
+	CHECK(tree.GetStats().leafOccupancy == fresh.GetStats().leafOccupancy);
+
+	unsigned int missing = 0;
+	Kdtree::IndexSpan spans[3];
+	for (unsigned int triangle = 0; triangle < triangles.size(); triangle++) {
+		unsigned int spanCount = tree.SearchTri(triangles[triangle], root, spans);
+		for (unsigned int span = 0; span < spanCount; span++) {
+			if (std::find(spans[span].begin(), spans[span].end(), triangle) == spans[span].end())
+				missing++;
+		}
+	}
+	CHECK(missing == 0);
+}
+
+//Squared distance from p to the closest point of a triangle: its projection onto the plane
+//when that falls inside, otherwise the closest point of the three edges.
+static float SurfaceDistanceSq(const Triangle& triangle, XMVECTOR p)
+{
+	XMVECTOR corners[3];
+	for (int i = 0; i < 3; i++)
+		corners[i] = XMLoadFloat3(&triangle.triangleVertices[i]);
+	XMVECTOR normal = XMVector3Cross(XMVectorSubtract(corners[1], corners[0]), XMVectorSubtract(corners[2], corners[0]));
+	float normalSq = XMVectorGetX(XMVector3LengthSq(normal));
+	if (normalSq > 0.0f) {
+		XMVECTOR projected = XMVectorSubtract(p, XMVectorScale(normal, XMVectorGetX(XMVector3Dot(XMVectorSubtract(p, corners[0]), normal)) / normalSq));
+		bool inside = true;
+		for (int i = 0; i < 3; i++) {
+			XMVECTOR edge = XMVectorSubtract(corners[(i + 1) % 3], corners[i]);
+			inside = inside && XMVectorGetX(XMVector3Dot(XMVector3Cross(edge, XMVectorSubtract(projected, corners[i])), normal)) >= 0.0f;
+		}
+		if (inside)
+			return XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(p, projected)));
+	}
+	float best = std::numeric_limits<float>::infinity();
+	for (int i = 0; i < 3; i++) {
+		XMVECTOR edge = XMVectorSubtract(corners[(i + 1) % 3], corners[i]);
+		float lengthSq = XMVectorGetX(XMVector3LengthSq(edge));
+		float t = lengthSq > 0.0f ? XMVectorGetX(XMVector3Dot(XMVectorSubtract(p, corners[i]), edge)) / lengthSq : 0.0f;
+		XMVECTOR closest = XMVectorAdd(corners[i], XMVectorScale(edge, std::min(std::max(t, 0.0f), 1.0f)));
+		best = std::min(best, XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(p, closest))));
+	}
+	return best;
+}
+
+static bool Close(float a, float b)
+{
+	return std::fabs(a - b) <= 1e-5f * std::max(1.0f, b);
+}
+
+//Results are distinct triangles in ascending order, each at the distance the brute force
+//finds for it.
+static bool ValidResults(const Kdtree::Neighbour* results, unsigned int count, const std::vector<float>& distances)
+{
+	std::vector<unsigned int> found;
+	for (unsigned int i = 0; i < count; i++) {
+		if (!Close(results[i].distanceSq, distances[results[i].triangle]) || (i > 0 && results[i].distanceSq < results[i - 1].distanceSq))
+			return false;
+		found.push_back(results[i].triangle);
+	}
+	std::sort(found.begin(), found.end());
+	return std::adjacent_find(found.begin(), found.end()) == found.end();
+}
+
+//SearchNearest and SearchRadius against a scan of every triangle, for both metrics, on a
+//fresh tree and on one whose triangles were partly removed and inserted again. k may be
+//larger than the tree, and radius results are also checked truncated to capacity.
+static void TestNeighbourQueries(const TestMesh& mesh)
+{
+	ScratchVector<Triangle> triangles = mesh.Triangles();
+	unsigned int triangleCount = (unsigned int)triangles.size();
+	Kdtree fresh;
+	Kdtree::NodeIndex freshRoot = fresh.Create(triangles, 0, 100);
+	fresh.InsertAll(freshRoot);
+	Kdtree updated;
+	Kdtree::NodeIndex updatedRoot = updated.Create(triangles, 0, 100);
+	updated.InsertAll(updatedRoot);
+	std::vector<unsigned int> changed;
+	for (unsigned int triangle = 0; triangle < triangleCount; triangle += 7)
+		changed.push_back(triangle);
+	updated.Remove(changed, updatedRoot);
+	updated.Insert(changed, updatedRoot);
+	const Kdtree* trees[2] = { &fresh, &updated };
+	Kdtree::NodeIndex roots[2] = { freshRoot, updatedRoot };
+
+	std::mt19937 random(11);
+	std::uniform_real_distribution<float> x(-0.5f, 5.5f), y(-0.5f, 3.0f), z(-0.5f, 4.5f);
+	const Kdtree::DistanceMetric metrics[] = { Kdtree::CENTROID, Kdtree::SURFACE };
+	const unsigned int ks[] = { 1, 7, 40, triangleCount + 5 };
+	const float radius = 0.3f;
+	std::vector<Kdtree::Neighbour> results(triangleCount + 5);
+	unsigned int truncated = 0;
+	for (unsigned int probe = 0; probe < 100; probe++) {
+		XMFLOAT3 point(x(random), y(random), z(random));
+		if (probe % 4 == 0)
+			point = triangles[random() % triangleCount].triangleVertices[0];
+		for (Kdtree::DistanceMetric metric : metrics) {
+			std::vector<float> distances(triangleCount);
+			for (unsigned int triangle = 0; triangle < triangleCount; triangle++) {
+				distances[triangle] = metric == Kdtree::CENTROID
+					? XMVectorGetX(XMVector3LengthSq(XMVectorSubtract(XMLoadFloat3(&triangles[triangle].position), XMLoadFloat3(&point))))
+					: SurfaceDistanceSq(triangles[triangle], XMLoadFloat3(&point));
+			}
+			std::vector<float> sorted = distances;
+			std::sort(sorted.begin(), sorted.end());
+			unsigned int within = 0, borderline = 0;
+			for (float distanceSq : distances) {
+				within += distanceSq <= radius * radius;
+				borderline += Close(distanceSq, radius * radius);
+			}
+
+			for (int tree = 0; tree < 2; tree++) {
+				for (unsigned int k : ks) {
+					unsigned int count = trees[tree]->SearchNearest(point, k, metric, results.data(), roots[tree]);
+					CHECK(count == std::min(k, triangleCount));
+					CHECK(ValidResults(results.data(), count, distances));
+					for (unsigned int i = 0; i < count; i++)
+						CHECK(Close(results[i].distanceSq, sorted[i]));
+				}
+
+				unsigned int count = trees[tree]->SearchRadius(point, radius, metric, results.data(), triangleCount, roots[tree]);
+				CHECK(ValidResults(results.data(), count, distances));
+				if (borderline == 0)
+					CHECK(count == within);
+				if (within >= 2) {
+					unsigned int capacity = within / 2;
+					count = trees[tree]->SearchRadius(point, radius, metric, results.data(), capacity, roots[tree]);
+					CHECK(count == capacity);
+					CHECK(ValidResults(results.data(), count, distances));
+					for (unsigned int i = 0; i < count; i++)
+						CHECK(results[i].distanceSq <= radius * radius);
+					truncated++;
+				}
+			}
+		}
+	}
+	CHECK(truncated > 0);
+}
+
+//Counts the reachable child pairs that do not start on a 16-byte boundary.
+static unsigned int MisalignedPairs(const Kdtree& tree, Kdtree::NodeIndex node)
+{
+	const Kdtree::Node& current = tree.GetNode(node);
+	if (current.IsLeaf())
+		return 0;
+	unsigned int misaligned = (uintptr_t)&tree.GetNode(current.LeftChild()) % 16 != 0;
+	return misaligned + MisalignedPairs(tree, current.LeftChild()) + MisalignedPairs(tree, current.RightChild());
+}
+
+//Child pairs stay 16-byte aligned for every builder, on the heap and in an arena, and
+//through the grafts and compactions of updates.
+static void TestNodeAlignment(const ScratchVector<Triangle>& triangles)
+{
+	ScratchArena arena;
+	ScratchArena* arenas[2] = { nullptr, &arena };
+	for (ScratchArena* storage : arenas) {
+		//Shift the arena off its block alignment first.
+		if (storage)
+			storage->Allocate(4, 4);
+		Kdtree tree(storage);
+		Kdtree::NodeIndex root = tree.Create(triangles, 0, 100, Kdtree::SORT_COPY);
+		CHECK(MisalignedPairs(tree, root) == 0);
+		tree.SetSplitStrategy(Kdtree::SAH);
+		tree.SetParallelBuild(4, 256);
+		root = tree.Create(triangles, 0, 100);
+		CHECK(MisalignedPairs(tree, root) == 0);
+		tree.InsertAll(root);
+		std::vector<unsigned int> updated;
+		for (unsigned int triangle = 0; triangle < triangles.size(); triangle += 4)
+			updated.push_back(triangle);
+		tree.Remove(updated, root);
+		tree.Insert(updated, root);
+		CHECK(MisalignedPairs(tree, root) == 0);
+	}
+}
+
+//Points on every split plane of the tree, just below it, and far outside the mesh bounds
+//on each side, in the order of the random ones around them.
+static std::vector<XMFLOAT3> LocatePoints(const Kdtree& tree, Kdtree::NodeIndex root, std::mt19937& random)
+{
+	std::uniform_real_distribution<float> x(0.0f, 5.0f), y(0.0f, 2.5f), z(0.0f, 4.0f);
+	std::vector<XMFLOAT3> points;
+	std::vector<Kdtree::NodeIndex> stack(1, root);
+	while (!stack.empty()) {
+		const Kdtree::Node& node = tree.GetNode(stack.back());
+		stack.pop_back();
+		if (node.IsLeaf())
+			continue;
+		stack.push_back(node.LeftChild());
+		stack.push_back(node.RightChild());
+		if (random() % 8 != 0)
+			continue;
+		XMFLOAT3 on(x(random), y(random), z(random));
+		float* coords = &on.x;
+		coords[node.SplitAxis()] = node.split;
+		points.push_back(on);
+		coords[node.SplitAxis()] = std::nextafter(node.split, -std::numeric_limits<float>::infinity());
+		points.push_back(on);
+	}
+	const float outside[] = { -1e30f, -50.0f, 50.0f, 1e30f, -std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity() };
+	for (float value : outside) {
+		for (int axis = 0; axis < 3; axis++) {
+			XMFLOAT3 point(x(random), y(random), z(random));
+			(&point.x)[axis] = value;
+			points.push_back(point);
+		}
+		points.push_back(XMFLOAT3(value, value, value));
+	}
+	std::shuffle(points.begin(), points.end(), random);
+	return points;
+}
+
+//The batched SearchPos finds the same leaf as the scalar one for every count, whether or
+//not it is a multiple of four, and from every start, so each lane sees every point.
+static void TestBatchedSearchPos(const ScratchVector<Triangle>& triangles)
+{
+	std::mt19937 random(13);
+	const Kdtree::SplitStrategy strategies[] = { Kdtree::MEDIAN, Kdtree::SAH };
+	for (Kdtree::SplitStrategy strategy : strategies) {
+		Kdtree tree;
+		tree.SetSplitStrategy(strategy);
+		Kdtree::NodeIndex root = tree.Create(triangles, 0, 100);
+		std::vector<XMFLOAT3> points = LocatePoints(tree, root, random);
+		CHECK(points.size() > 100);
+		std::vector<Kdtree::NodeIndex> expected(points.size());
+		for (size_t i = 0; i < points.size(); i++)
+			expected[i] = tree.SearchPos(points[i], root);
+
+		std::vector<Kdtree::NodeIndex> leaves(points.size() + 1);
+		for (unsigned int first = 0; first < 4; first++) {
+			for (unsigned int count = 0; first + count <= points.size(); count += count < 19 ? 1 : 97) {
+				leaves[count] = Kdtree::ROOT;
+				tree.SearchPos(points.data() + first, count, root, leaves.data());
+				for (unsigned int i = 0; i < count; i++)
+					CHECK(leaves[i] == expected[first + i]);
+				//Nothing is written past the last point.
+				CHECK(leaves[count] == Kdtree::ROOT);
+			}
+		}
+	}
+}
+
+int main()
+{
+	TestMesh room = MakeRoom(12);
+	ScratchVector<Triangle> triangles = room.Triangles();
+
+	TestConcurrentQueryStats(triangles);
+	TestNodeAlignment(triangles);
+	TestUpdateCounts(room);
+	TestUpdateCounts(MakeGrid(150));
+	TestRebuildShape(room);
+	TestRebuildShape(MakeGrid(150));
+	TestRebuildFallback(room);
+	TestNeighbourQueries(MakeRoom(3));
+	TestBatchedSearchPos(triangles);
+
+	return TestResult();
+}
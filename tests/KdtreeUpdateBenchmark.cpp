@@ -0,0 +1,88 @@
+#include "TestMesh.h"
+#include "Benchmark.h"
+#include "Kdtree.h"
+#include <memory>
+
+//Removes and re-inserts every step-th triangle of a surface and compares the resulting
+//tree and the time taken with a fresh build over the same triangles.
+static void Run(const char* name, const TestMesh& mesh)
+{
+	ScratchVector<Triangle> triangles = mesh.Triangles();
+
+	std::unique_ptr<Kdtree> tree;
+	Kdtree::NodeIndex root = Kdtree::ROOT;
+	auto build = [&] {
+		tree.reset(new Kdtree());
+		root = tree->Create(triangles, 0, 100);
+		tree->InsertAll(root);
+	};
+	double buildTime = BestMilliseconds(5, [] {}, build);
+	Kdtree::Stats fresh = tree->GetStats();
+	Kdtree::QueryCost freshCost = tree->MeasureQueryCost(triangles, root);
+	std::printf("%s, %u triangles: fresh build %.2f ms, depth %u, %u nodes, %.1f nodes and %.1f candidates per query\n",
+		name, (unsigned int)triangles.size(), buildTime, (unsigned int)fresh.depthHistogram.size() - 1, fresh.nodeCount,
+		freshCost.visitedNodes, freshCost.candidates);
+
+	const unsigned int steps[] = { 100, 20, 10, 3 };
+	for (unsigned int step : steps) {
+		std::vector<unsigned int> updated;
+		for (unsigned int triangle = 0; triangle < triangles.size(); triangle += step)
+			updated.push_back(triangle);
+		double updateTime = BestMilliseconds(5, build, [&] {
+			tree->Remove(updated, root);
+			tree->Insert(updated, root);
+		});
+		Kdtree::Stats stats = tree->GetStats();
+		Kdtree::QueryCost cost = tree->MeasureQueryCost(triangles, root);
+		std::printf("  update 1/%u (%u triangles): %.2f ms (%.0f%% of a build), depth %u, %u nodes, %.1f nodes and %.1f candidates per query\n",
+			step, (unsigned int)updated.size(), updateTime, 100.0 * updateTime / buildTime, (unsigned int)stats.depthHistogram.size() - 1,
+			stats.nodeCount, cost.visitedNodes, cost.candidates);
+	}
+}
+
+//Builds a tree over the first part of a surface and inserts the rest, as a surface that
+//grows into a region the tree has not seen. Past 40% of the tree the insert rebuilds it.
+static void Grow(const char* name, const TestMesh& mesh)
+{
+	ScratchVector<Triangle> triangles = mesh.Triangles();
+	std::unique_ptr<Kdtree> tree;
+	Kdtree::NodeIndex root = Kdtree::ROOT;
+	double buildTime = BestMilliseconds(5, [&] {
+		tree.reset(new Kdtree());
+		root = tree->Create(triangles, 0, 100);
+		tree->InsertAll(root);
+	});
+	std::printf("%s grows, fresh build %.2f ms\n", name, buildTime);
+
+	const double fractions[] = { 0.05, 0.25, 0.35, 0.5, 1.0 };
+	for (double fraction : fractions) {
+		unsigned int kept = (unsigned int)(triangles.size() / (1.0 + fraction));
+		ScratchVector<Triangle> source(triangles.begin(), triangles.begin() + kept);
+		source.reserve(triangles.size());
+		std::vector<unsigned int> added;
+		for (unsigned int triangle = kept; triangle < triangles.size(); triangle++)
+			added.push_back(triangle);
+		double growTime = BestMilliseconds(5, [&] {
+			source.resize(kept);
+			tree.reset(new Kdtree());
+			root = tree->Create(source, 0, 100);
+			tree->InsertAll(root);
+			source.insert(source.end(), triangles.begin() + kept, triangles.end());
+		}, [&] {
+			tree->Insert(added, root);
+		});
+		Kdtree::Stats stats = tree->GetStats();
+		std::printf("  insert %.0f%% of the tree (%u triangles): %.2f ms (%.0f%% of a build), depth %u, %u nodes\n",
+			100.0 * fraction, (unsigned int)added.size(), growTime, 100.0 * growTime / buildTime,
+			(unsigned int)stats.depthHistogram.size() - 1, stats.nodeCount);
+	}
+}
+
+int main()
+{
+	Run("grid 150x150", MakeGrid(150));
+	Run("room", MakeRoom(12));
+	Grow("grid 150x150", MakeGrid(150));
+	Grow("room", MakeRoom(12));
+	return 0;
+}
@@ -0,0 +1,73 @@
+#include "TestMesh.h"
+#include "MeshView.h"
+#include <cmath>
+
+using namespace DirectX;
+
+//Only known formats with strides that hold their elements are supported.
+static void TestSupported()
+{
+	TestMesh mesh = MakeGrid(2);
+	CHECK(!MeshView().IsSupported());
+	CHECK(mesh.View().IsSupported());
+
+	MeshView view = mesh.View();
+	view.SetPositions(mesh.positions.data(), (unsigned int)mesh.positions.size(), sizeof(XMFLOAT3), MeshView::POSITION_UNSUPPORTED, XMFLOAT3(1.0f, 1.0f, 1.0f));
+	CHECK(!view.IsSupported());
+	view = mesh.View();
+	view.SetNormals(mesh.normals.data(), (unsigned int)mesh.normals.size(), sizeof(XMFLOAT3), MeshView::NORMAL_UNSUPPORTED);
+	CHECK(!view.IsSupported());
+	view = mesh.View();
+	view.SetIndices(mesh.indices.data(), (unsigned int)mesh.indices.size(), MeshView::INDEX_UNSUPPORTED);
+	CHECK(!view.IsSupported());
+	view = mesh.View();
+	view.SetPositions(mesh.positions.data(), (unsigned int)mesh.positions.size(), 8, MeshView::POSITION_FLOAT32, XMFLOAT3(1.0f, 1.0f, 1.0f));
+	CHECK(!view.IsSupported());
+	view = mesh.View();
+	view.SetNormals(mesh.normals.data(), (unsigned int)mesh.normals.size(), 4, MeshView::NORMAL_FLOAT32);
+	CHECK(!view.IsSupported());
+}
+
+//Both supported layouts of each stream decode to the same values, including four-float
+//elements with a 16-byte stride.
+static void TestLayouts()
+{
+	PackedVector::XMSHORTN4 packedPositions[2] = { { 32767, -32768, 0, 0 }, { 16384, 0, -16384, 0 } };
+	float floatPositions[2][4] = { { 1.0f, -1.0f, 0.0f, 1.0f }, { 16384 / 32767.0f, 0.0f, -16384 / 32767.0f, 1.0f } };
+	PackedVector::XMBYTEN4 packedNormals[2] = { { 127, 0, 0, 0 }, { 0, -128, 0, 0 } };
+	float floatNormals[2][4] = { { 1.0f, 0.0f, 0.0f, 0.0f }, { 0.0f, -1.0f, 0.0f, 0.0f } };
+	unsigned short shortIndices[3] = { 0, 1, 1 };
+	unsigned int intIndices[3] = { 0, 1, 1 };
+	XMFLOAT3 scale(2.0f, 3.0f, 4.0f);
+
+	MeshView packed;
+	packed.SetPositions(packedPositions, 2, sizeof(PackedVector::XMSHORTN4), MeshView::POSITION_SNORM16, scale);
+	packed.SetNormals(packedNormals, 2, sizeof(PackedVector::XMBYTEN4), MeshView::NORMAL_SNORM8);
+	packed.SetIndices(shortIndices, 3, MeshView::INDEX_UINT16);
+	MeshView wide;
+	wide.SetPositions(floatPositions, 2, 4 * sizeof(float), MeshView::POSITION_FLOAT32, scale);
+	wide.SetNormals(floatNormals, 2, 4 * sizeof(float), MeshView::NORMAL_FLOAT32);
+	wide.SetIndices(intIndices, 3, MeshView::INDEX_UINT32);
+	CHECK(packed.IsSupported() && wide.IsSupported());
+	CHECK(packed.PackedPositions() && packed.PackedNormals());
+	CHECK(!wide.PackedPositions() && !wide.PackedNormals());
+
+	//SNORM loads may multiply by the reciprocal of 32767 or 127 instead of dividing.
+	auto near = [](const XMFLOAT3& a, const XMFLOAT3& b) {
+		return std::fabs(a.x - b.x) <= 1e-6f && std::fabs(a.y - b.y) <= 1e-6f && std::fabs(a.z - b.z) <= 1e-6f;
+	};
+	for (unsigned int v = 0; v < 2; v++) {
+		CHECK(near(packed.Position(v), wide.Position(v)));
+		CHECK(near(packed.Normal(v), wide.Normal(v)));
+	}
+	CHECK(near(packed.Position(0), XMFLOAT3(2.0f, -3.0f, 0.0f)));
+	for (unsigned int i = 0; i < 3; i++)
+		CHECK(packed.Index(i) == wide.Index(i));
+}
+
+int main()
+{
+	TestSupported();
+	TestLayouts();
+	return TestResult();
+}
@@ -0,0 +1,51 @@
+#include "TestMesh.h"
+#include "Benchmark.h"
+#include "Kdtree.h"
+#include "SpatialGrid.h"
+
+//Compares Kdtree and SpatialGrid as the neighbour index of PopulateEdgeList: the time to
+//build and fill each, and the time and work of one SearchTri per triangle.
+static void Run(const char* name, const TestMesh& mesh)
+{
+	ScratchVector<Triangle> triangles = mesh.Triangles();
+	unsigned int count = (unsigned int)triangles.size();
+	unsigned int found = 0;
+	Kdtree::IndexSpan spans[3];
+
+	Kdtree tree;
+	Kdtree::NodeIndex root = Kdtree::ROOT;
+	double treeBuild = BestMilliseconds(3, [&] {
+		root = tree.Create(triangles, 0, 100);
+		tree.InsertAll(root);
+	});
+	double treeQuery = BestMilliseconds(3, [&] {
+		for (const Triangle& triangle : triangles)
+			found += tree.SearchTri(triangle, root, spans);
+	});
+	Kdtree::QueryCost treeCost = tree.MeasureQueryCost(triangles, root);
+
+	SpatialGrid grid;
+	double gridBuild = BestMilliseconds(3, [&] {
+		grid.Create(triangles);
+		grid.InsertAll();
+	});
+	double gridQuery = BestMilliseconds(3, [&] {
+		for (const Triangle& triangle : triangles)
+			found += grid.SearchTri(triangle, spans);
+	});
+	Kdtree::QueryCost gridCost = grid.MeasureQueryCost(triangles);
+
+	std::printf("%s, %u triangles (%u spans)\n", name, count, found);
+	std::printf("  kd-tree: build %8.2f ms, queries %8.2f ms (%5.1f M/s), %5.1f nodes, %6.1f candidates\n",
+		treeBuild, treeQuery, count / treeQuery / 1000.0, treeCost.visitedNodes, treeCost.candidates);
+	std::printf("  grid:    build %8.2f ms, queries %8.2f ms (%5.1f M/s), %5.1f buckets, %6.1f candidates\n",
+		gridBuild, gridQuery, count / gridQuery / 1000.0, gridCost.visitedNodes, gridCost.candidates);
+}
+
+int main()
+{
+	Run("room", MakeRoom(28));
+	Run("room", MakeRoom(88));
+	Run("flat grid", MakeGrid(224));
+	return 0;
+}
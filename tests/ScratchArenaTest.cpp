@@ -0,0 +1,47 @@
+#include "TestMesh.h"
+#include "ScratchArena.h"
+
+//Over-aligned allocations honour the alignment in an arena and on the heap.
+template <size_t Alignment>
+static void TestAlignment()
+{
+	ScratchArena arena(256);
+	ScratchArena* arenas[2] = { nullptr, &arena };
+	for (ScratchArena* storage : arenas) {
+		ArenaAllocator<char, Alignment> allocator(storage);
+		for (size_t size = 1; size < 1000; size += 37) {
+			char* memory = allocator.allocate(size);
+			CHECK((uintptr_t)memory % Alignment == 0);
+			memory[0] = memory[size - 1] = 1;
+			allocator.deallocate(memory, size);
+		}
+	}
+}
+
+//A surface that outgrew the first block is served from one merged block after Reset.
+static void TestReset()
+{
+	ScratchArena arena(1024);
+	ScratchVector<int> values(&arena);
+	for (int i = 0; i < 10000; i++)
+		values.push_back(i);
+	ScratchArena::Counters grown = arena.GetCounters();
+	CHECK(grown.systemAllocations > 1);
+
+	arena.Reset();
+	CHECK(arena.GetCounters().systemAllocations == 1);
+	CHECK(arena.GetCounters().capacity == grown.capacity);
+	ScratchVector<int> again(&arena);
+	for (int i = 0; i < 10000; i++)
+		again.push_back(i);
+	CHECK(arena.GetCounters().systemAllocations == 1);
+}
+
+int main()
+{
+	TestAlignment<16>();
+	TestAlignment<64>();
+	TestAlignment<256>();
+	TestReset();
+	return TestResult();
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "pch.h"
+#include "Triangle.h"
+#include "MeshView.h"
+#include "ScratchArena.h"
+#include <algorithm>
+#include <cstdio>
+#include <map>
+#include <random>
+#include <vector>
+
+//Shared by the tests and benchmarks: a failure counter for CHECK and synthetic surfaces
+//standing in for what the device delivers.
+
+inline unsigned int& TestFailures()
+{
+	static unsigned int failures = 0;
+	return failures;
+}
+
+//Reports a failed condition and keeps going; main returns TestResult().
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) { \
+			std::printf("%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+			TestFailures()++; \
+		} \
+	} while (0)
+
+inline int TestResult()
+{
+	if (TestFailures() == 0)
+		std::printf("passed\n");
+	return TestFailures() == 0 ? 0 : 1;
+}
+
+//Float positions and normals and 32-bit indices, as MeshView reads them.
+struct TestMesh
+{
+	std::vector<DirectX::XMFLOAT3> positions;
+	std::vector<DirectX::XMFLOAT3> normals;
+	std::vector<unsigned int> indices;
+
+	unsigned int TriangleCount() const { return (unsigned int)indices.size() / 3; }
+
+	MeshView View() const
+	{
+		MeshView view;
+		view.SetPositions(positions.data(), (unsigned int)positions.size(), sizeof(DirectX::XMFLOAT3), MeshView::POSITION_FLOAT32, DirectX::XMFLOAT3(1.0f, 1.0f, 1.0f));
+		view.SetNormals(normals.data(), (unsigned int)normals.size(), sizeof(DirectX::XMFLOAT3), MeshView::NORMAL_FLOAT32);
+		view.SetIndices(indices.data(), (unsigned int)indices.size(), MeshView::INDEX_UINT32);
+		return view;
+	}
+
+	ScratchVector<Triangle> Triangles(ScratchArena* arena = nullptr) const
+	{
+		ScratchVector<Triangle> triangles(arena);
+		triangles.reserve(TriangleCount());
+		for (size_t corner = 0; corner < indices.size(); corner += 3) {
+			unsigned int a = indices[corner], b = indices[corner + 1], c = indices[corner + 2];
+			triangles.push_back(Triangle(positions[a], positions[b], positions[c], normals[a], normals[b], normals[c]));
+		}
+		return triangles;
+	}
+};
+
+//A room of floor and four walls, each a noisy grid of density cells per metre. The walls
+//are separate grids, so the seams carry split vertices as the device meshes do.
+inline TestMesh MakeRoom(unsigned int density, unsigned int seed = 7)
+{
+	TestMesh mesh;
+	std::mt19937 random(seed);
+	std::uniform_real_distribution<float> noise(-0.002f, 0.002f);
+	auto addPlane = [&](DirectX::XMFLOAT3 origin, DirectX::XMFLOAT3 u, DirectX::XMFLOAT3 v, unsigned int cellsU, unsigned int cellsV) {
+		DirectX::XMFLOAT3 normal;
+		DirectX::XMStoreFloat3(&normal, DirectX::XMVector3Normalize(DirectX::XMVector3Cross(DirectX::XMLoadFloat3(&u), DirectX::XMLoadFloat3(&v))));
+		unsigned int base = (unsigned int)mesh.positions.size();
+		for (unsigned int j = 0; j <= cellsV; j++) {
+			for (unsigned int i = 0; i <= cellsU; i++) {
+				float a = i / (float)cellsU, b = j / (float)cellsV;
+				mesh.positions.push_back(DirectX::XMFLOAT3(
+					origin.x + u.x * a + v.x * b + noise(random),
+					origin.y + u.y * a + v.y * b + noise(random),
+					origin.z + u.z * a + v.z * b + noise(random)));
+				DirectX::XMFLOAT3 bent(normal.x + 20 * noise(random), normal.y + 20 * noise(random), normal.z + 20 * noise(random));
+				DirectX::XMStoreFloat3(&bent, DirectX::XMVector3Normalize(DirectX::XMLoadFloat3(&bent)));
+				mesh.normals.push_back(bent);
+			}
+		}
+		for (unsigned int j = 0; j < cellsV; j++) {
+			for (unsigned int i = 0; i < cellsU; i++) {
+				unsigned int a = base + j * (cellsU + 1) + i, b = a + 1, c = a + cellsU + 1, d = c + 1;
+				unsigned int quad[6] = { a, b, c, b, d, c };
+				mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+			}
+		}
+	};
+	addPlane(DirectX::XMFLOAT3(0, 0, 0), DirectX::XMFLOAT3(5, 0, 0), DirectX::XMFLOAT3(0, 0, 4), 5 * density, 4 * density);
+	addPlane(DirectX::XMFLOAT3(0, 0, 0), DirectX::XMFLOAT3(5, 0, 0), DirectX::XMFLOAT3(0, 2.5f, 0), 5 * density, 2 * density + density / 2);
+	addPlane(DirectX::XMFLOAT3(0, 0, 4), DirectX::XMFLOAT3(5, 0, 0), DirectX::XMFLOAT3(0, 2.5f, 0), 5 * density, 2 * density + density / 2);
+	addPlane(DirectX::XMFLOAT3(0, 0, 0), DirectX::XMFLOAT3(0, 0, 4), DirectX::XMFLOAT3(0, 2.5f, 0), 4 * density, 2 * density + density / 2);
+	addPlane(DirectX::XMFLOAT3(5, 0, 0), DirectX::XMFLOAT3(0, 0, 4), DirectX::XMFLOAT3(0, 2.5f, 0), 4 * density, 2 * density + density / 2);
+	return mesh;
+}
+
+//A flat square of cells x cells quads, split into two triangles each, one metre across.
+inline TestMesh MakeGrid(unsigned int cells)
+{
+	TestMesh mesh;
+	for (unsigned int j = 0; j <= cells; j++) {
+		for (unsigned int i = 0; i <= cells; i++) {
+			mesh.positions.push_back(DirectX::XMFLOAT3(i / (float)cells, j / (float)cells, 0.0f));
+			mesh.normals.push_back(DirectX::XMFLOAT3(0.0f, 0.0f, 1.0f));
+		}
+	}
+	for (unsigned int j = 0; j < cells; j++) {
+		for (unsigned int i = 0; i < cells; i++) {
+			unsigned int a = j * (cells + 1) + i, b = a + 1, c = a + cells + 1, d = c + 1;
+			unsigned int quad[6] = { a, b, c, b, d, c };
+			mesh.indices.insert(mesh.indices.end(), quad, quad + 6);
+		}
+	}
+	return mesh;
+}
+
+//Segments with their endpoints in a fixed order, sorted, so two extractions can be
+//compared regardless of the order they visit the edges in.
+inline std::vector<std::pair<unsigned int, unsigned int>> SortedSegments(const ScratchVector<DirectX::XMFLOAT3>& lines, const TestMesh& mesh)
+{
+	typedef std::pair<float, std::pair<float, float>> Key;
+	std::map<Key, unsigned int> vertices;
+	for (unsigned int v = 0; v < mesh.positions.size(); v++)
+		vertices[Key(mesh.positions[v].x, std::make_pair(mesh.positions[v].y, mesh.positions[v].z))] = v;
+	//A line vertex that is not a mesh vertex maps past the last one, so it cannot match.
+	auto vertex = [&](const DirectX::XMFLOAT3& position) {
+		auto found = vertices.find(Key(position.x, std::make_pair(position.y, position.z)));
+		return found == vertices.end() ? (unsigned int)mesh.positions.size() : found->second;
+	};
+	std::vector<std::pair<unsigned int, unsigned int>> segments;
+	for (size_t i = 0; i < lines.size(); i += 2) {
+		unsigned int a = vertex(lines[i]), b = vertex(lines[i + 1]);
+		segments.push_back(std::make_pair(std::min(a, b), std::max(a, b)));
+	}
+	std::sort(segments.begin(), segments.end());
+	return segments;
+}
@@ -0,0 +1,72 @@
+#include "TestMesh.h"
+#include "QuantizedWeld.h"
+#include "VertexWeld.h"
+#include <cmath>
+
+using namespace DirectX;
+
+//With an epsilon of 0 float positions weld only when their bits match, -0 aside. Welded
+//ids follow first appearance and the representative is the first vertex of each.
+static void TestExactFloatWeld()
+{
+	float next = std::nextafter(0.5f, 1.0f);
+	XMFLOAT3 positions[] = {
+		XMFLOAT3(0.5f, 0.25f, 1.0f),
+		XMFLOAT3(0.0f, 0.0f, 0.0f),
+		XMFLOAT3(next, 0.25f, 1.0f),
+		XMFLOAT3(-0.0f, 0.0f, -0.0f),
+		XMFLOAT3(0.5f, 0.25f, 1.0f),
+		XMFLOAT3(0.5f, 0.25f, 1.0001f),
+	};
+	unsigned int expected[] = { 0, 1, 2, 1, 0, 3 };
+	VertexWeld weld;
+	weld.Build(positions, 6, 0.0f);
+	CHECK(weld.WeldedCount() == 4);
+	CHECK(weld.MergedCount() == 2);
+	for (unsigned int v = 0; v < 6; v++)
+		CHECK(weld.Welded(v) == expected[v]);
+	CHECK(weld.Representative(2) == 2);
+	CHECK(weld.Representative(3) == 5);
+}
+
+//A grid split into separate triangles, as the device splits vertices along its seams,
+//with positions on the SNORM grid. The packed weld, the exact float weld and a tolerance
+//weld below the cell size all join it back into the original vertices.
+static void TestSplitGrid()
+{
+	const unsigned int cells = 40;
+	TestMesh grid = MakeGrid(cells);
+	unsigned int count = (unsigned int)grid.indices.size();
+	std::vector<PackedVector::XMSHORTN4> packed(count);
+	std::vector<XMFLOAT3> decoded(count);
+	for (unsigned int corner = 0; corner < count; corner++) {
+		const XMFLOAT3& p = grid.positions[grid.indices[corner]];
+		packed[corner].x = (short)std::lround(p.x * 32767);
+		packed[corner].y = (short)std::lround(p.y * 32767);
+		packed[corner].z = (short)std::lround(p.z * 32767);
+		packed[corner].w = 0;
+		decoded[corner] = XMFLOAT3(packed[corner].x / 32767.0f, packed[corner].y / 32767.0f, packed[corner].z / 32767.0f);
+	}
+	unsigned int vertexCount = (cells + 1) * (cells + 1);
+
+	QuantizedWeld quantized;
+	quantized.Build(packed.data(), count);
+	VertexWeld exact;
+	exact.Build(decoded.data(), count, 0.0f);
+	VertexWeld tolerant;
+	tolerant.Build(decoded.data(), count, 0.1f / cells);
+	CHECK(quantized.WeldedCount() == vertexCount);
+	CHECK(exact.WeldedCount() == vertexCount);
+	CHECK(tolerant.WeldedCount() == vertexCount);
+	for (unsigned int corner = 0; corner < count; corner++) {
+		CHECK(exact.Welded(corner) == quantized.Welded(corner));
+		CHECK(tolerant.Welded(corner) == quantized.Welded(corner));
+	}
+}
+
+int main()
+{
+	TestExactFloatWeld();
+	TestSplitGrid();
+	return TestResult();
+}
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <thread>
+#include <atomic>
+#include <vector>
+
+//The parts of the Parallel Patterns Library the geometry code uses, on std::thread, for
+//building the tests where PPL is not available. There is no worker pool: parallel_invoke
+//runs its second function on a new thread and parallel_for starts one thread per core.
+namespace concurrency
+{
+	template <class F1, class F2>
+	void parallel_invoke(const F1& f1, const F2& f2)
+	{
+		std::thread second(f2);
+		f1();
+		second.join();
+	}
+
+	template <class Index, class F>
+	void parallel_for(Index first, Index last, const F& f)
+	{
+		std::atomic<Index> next(first);
+		auto work = [&]() {
+			for (Index i = next++; i < last; i = next++)
+				f(i);
+		};
+		std::vector<std::thread> workers;
+		for (unsigned int worker = 1; worker < std::thread::hardware_concurrency(); worker++)
+			workers.emplace_back(work);
+		work();
+		for (std::thread& worker : workers)
+			worker.join();
+	}
+}